@@ -1,6 +1,7 @@
 #include "accounts.h"
 #include "json.h"
 #include "main.h"
+#include "interned_strings.h"
 
 // TODO those are per account, do we even care about that?
 static Custom_Field* custom_fields = NULL;
@@ -9,7 +10,7 @@ static u32 custom_fields_count = 0;
 Account* accounts = NULL;
 u32 accounts_count = 0;
 
-static Id_Hash_Map<Custom_Field_Id, Custom_Field*> id_to_custom_field = {};
+Entity_Registry<Custom_Field> custom_field_registry{};
 
 static void process_custom_field(char* json, jsmntok_t*& token) {
     jsmntok_t* object_token = token++;
@@ -28,7 +29,7 @@ static void process_custom_field(char* json, jsmntok_t*& token) {
         if (json_string_equals(json, property_token, "id")) {
             json_token_to_right_part_of_id16(json, next_token, custom_field->id);
         } else if (json_string_equals(json, property_token, "title")) {
-            json_token_to_string(json, next_token, custom_field->title);
+            json_token_to_interned_string(json, next_token, custom_field->title);
         } else if (json_string_equals(json, property_token, "type")) {
 
             if (json_string_equals(json, next_token, "Text")) {
@@ -48,17 +49,11 @@ static void process_custom_field(char* json, jsmntok_t*& token) {
         }
     }
 
-    custom_field->id_hash = hash_id(custom_field->id);
-
-    id_hash_map_put(&id_to_custom_field, custom_field, custom_field->id, custom_field->id_hash);
+    entity_set(custom_field_registry, entity_register(custom_field_registry, custom_field->id), custom_field);
 }
 
-Custom_Field* find_custom_field_by_id(Custom_Field_Id id, u32 id_hash) {
-    if (!id_hash) {
-        id_hash = hash_id(id);
-    }
-
-    return id_hash_map_get(&id_to_custom_field, id, id_hash);
+Custom_Field* find_custom_field_by_id(Custom_Field_Id id) {
+    return entity_get(custom_field_registry, entity_find(custom_field_registry, id));
 }
 
 void process_accounts_data(char* json, u32 data_size, jsmntok_t*&token) {
@@ -91,7 +86,7 @@ void process_accounts_data(char* json, u32 data_size, jsmntok_t*&token) {
 
                 // TODO broken with more than 1 account!
                 custom_fields = (Custom_Field*) MALLOC(sizeof(Custom_Field) * next_token->size);
-                id_hash_map_init(&id_to_custom_field);
+                entity_registry_forget_entities(custom_field_registry);
 
                 for (u32 field_index = 0; field_index < next_token->size; field_index++) {
                     process_custom_field(json, token);
@@ -104,4 +99,10 @@ void process_accounts_data(char* json, u32 data_size, jsmntok_t*&token) {
             }
         }
     }
-}
\ No newline at end of file
+}
+
+void keep_account_interned_strings() {
+    for (u32 index = 0; index < custom_fields_count; index++) {
+        keep_interned_string(custom_fields[index].title);
+    }
+}
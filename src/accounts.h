@@ -1,7 +1,7 @@
 #pragma once
 
 #include <jsmn.h>
-#include "id_hash_map.h"
+#include "entity_registry.h"
 
 enum Custom_Field_Type {
     Custom_Field_Type_None,
@@ -18,7 +18,6 @@ enum Custom_Field_Type {
 
 struct Custom_Field {
     Custom_Field_Id id;
-    u32 id_hash;
     String title;
     Custom_Field_Type type;
 };
@@ -29,6 +28,8 @@ struct Account {
 
 extern Account* accounts;
 extern u32 accounts_count;
+extern Entity_Registry<Custom_Field> custom_field_registry;
 
 void process_accounts_data(char* json, u32 data_size, jsmntok_t*&token);
-Custom_Field* find_custom_field_by_id(Custom_Field_Id id, u32 id_hash = 0);
\ No newline at end of file
+Custom_Field* find_custom_field_by_id(Custom_Field_Id id);
+void keep_account_interned_strings();
\ No newline at end of file
@@ -0,0 +1,684 @@
+#include <cstring>
+#include <cstdio>
+#include <atomic>
+#include "avatar_cache.h"
+#include "id_hash_map.h"
+#include "lazy_array.h"
+#include "platform.h"
+#include "main.h"
+#include "tracing.h"
+
+/**
+ * File layout is a header followed by any number of records, each record is immediately followed by
+ *  width * height RGBA pixels. New avatars are appended to the end of the file as they arrive, until the
+ *  file reaches avatar_cache_max_file_size. Avatars past that are only kept for the session.
+ *
+ * Appends are collected and written in batches by a job, at most one write is in flight so they reach the
+ *  file in order.
+ */
+struct Avatar_Cache_File_Header {
+    u32 magic;
+    u32 version;
+};
+
+struct Avatar_Cache_Record {
+    u64 url_hash;
+    u16 width;
+    u16 height;
+};
+
+/**
+ * Pixels are only kept within avatar_pixel_budget_bytes. Evicted avatars which are in the file are read back
+ *  from there when they are drawn again, the others are forgotten and come from the network again.
+ */
+struct Cached_Avatar {
+    u8* pixels; // NULL when evicted or while being read from the file
+    u32 width;
+    u32 height;
+    u32 file_offset; // Of the pixels, 0 when the avatar is not in the file
+    bool is_being_read;
+    bool is_forgotten; // Nothing left of it, until avatar_cache_take_forgotten hands it out
+
+    Memory_Image texture{};
+    u32 last_drawn_at;
+
+    // Intrusive LRU list of avatars which have a texture, indices into cached_avatars
+    s32 more_recently_drawn;
+    s32 less_recently_drawn;
+
+    // Same for avatars which have pixels
+    s32 more_recently_used;
+    s32 less_recently_used;
+};
+
+// Pixels of one avatar read from the file by a job
+struct Avatar_Read {
+    s32 avatar;
+    u32 file_offset;
+    u32 size;
+    u8* pixels;
+    bool succeeded;
+};
+
+const char* avatar_cache_file_path = "avatar_cache.bin";
+u32 avatar_texture_budget_bytes = 1024 * 1024 * 16;
+u32 avatar_pixel_budget_bytes = 1024 * 1024 * 8;
+
+static const u32 avatar_cache_magic = 0x31435641; // AVC1
+static const u32 avatar_cache_version = 1;
+static const u32 avatar_cache_max_side = 64;
+static const u32 avatar_cache_max_file_size = 1024 * 1024 * 32;
+static const u32 avatar_cache_write_batch_size = 1024 * 256;
+static const float avatar_cache_write_delay_ms = 2000.0f;
+
+static Lazy_Array<Cached_Avatar, 64> cached_avatars{};
+static Id_Hash_Map<u64, s32, -1, Prehashed_Hasher> url_hash_to_cached_avatar{};
+
+static s32 most_recently_drawn = -1;
+static s32 least_recently_drawn = -1;
+static u32 resident_texture_bytes = 0;
+static u32 num_resident_textures = 0;
+static u32 num_evicted_textures = 0;
+
+static s32 most_recently_used = -1;
+static s32 least_recently_used = -1;
+static u32 resident_pixel_bytes = 0;
+static u32 num_evicted_pixels = 0;
+static u32 num_pixel_reads = 0;
+
+static bool finished_loading = false;
+
+// Including appends which are not written yet
+static u32 cache_file_size = 0;
+
+// What is in the file already, only records below this can be read back
+static u32 written_cache_file_size = 0;
+
+// Swapped when a write starts, so new appends never touch what the job is writing
+static char* pending_appends = NULL;
+static u32 pending_appends_length = 0;
+static u32 pending_appends_watermark = 0;
+static u64 first_pending_append_at = 0;
+
+static char* appends_being_written = NULL;
+static u32 appends_being_written_length = 0;
+static u32 appends_being_written_watermark = 0;
+
+// Either appends_being_written or a rewrite of the file content, see avatar_cache_process_file
+static char* write_data = NULL;
+static u32 write_length = 0;
+static bool write_appends = true;
+static bool is_write_running = false;
+static std::atomic<bool> is_write_done(false);
+
+// File content the rewrite is made from, freed once it's written
+static char* rewritten_file_content = NULL;
+
+// Same double buffering as the appends, reads are queued while drawing and started once per frame
+static Avatar_Read* pending_reads = NULL;
+static u32 pending_reads_length = 0;
+static u32 pending_reads_watermark = 0;
+
+static Avatar_Read* reads_running = NULL;
+static u32 reads_running_length = 0;
+static u32 reads_running_watermark = 0;
+
+static bool is_read_running = false;
+static std::atomic<bool> is_read_done(false);
+
+static inline u32 pixels_size_in_bytes(Cached_Avatar* avatar) {
+    return avatar->width * avatar->height * 4;
+}
+
+static void unlink_from_pixels_lru_list(Cached_Avatar* avatar) {
+    if (avatar->more_recently_used != -1) {
+        cached_avatars[avatar->more_recently_used].less_recently_used = avatar->less_recently_used;
+    } else {
+        most_recently_used = avatar->less_recently_used;
+    }
+
+    if (avatar->less_recently_used != -1) {
+        cached_avatars[avatar->less_recently_used].more_recently_used = avatar->more_recently_used;
+    } else {
+        least_recently_used = avatar->more_recently_used;
+    }
+
+    avatar->more_recently_used = -1;
+    avatar->less_recently_used = -1;
+}
+
+static void link_as_most_recently_used(s32 index) {
+    Cached_Avatar* avatar = &cached_avatars[index];
+    avatar->more_recently_used = -1;
+    avatar->less_recently_used = most_recently_used;
+
+    if (most_recently_used != -1) {
+        cached_avatars[most_recently_used].more_recently_used = index;
+    } else {
+        least_recently_used = index;
+    }
+
+    most_recently_used = index;
+}
+
+static inline bool can_be_read_back(Cached_Avatar* avatar) {
+    return avatar->file_offset && avatar->file_offset + pixels_size_in_bytes(avatar) <= written_cache_file_size;
+}
+
+// Avatars which are in the file but not written yet are skipped, they have nowhere to come back from
+static void evict_pixels_to_fit(u32 bytes_needed) {
+    s32 index = least_recently_used;
+
+    while (index != -1 && resident_pixel_bytes + bytes_needed > avatar_pixel_budget_bytes) {
+        Cached_Avatar* avatar = &cached_avatars[index];
+        s32 next = avatar->more_recently_used;
+
+        if (!avatar->file_offset || can_be_read_back(avatar)) {
+            unlink_from_pixels_lru_list(avatar);
+
+            FREE(avatar->pixels);
+            avatar->pixels = NULL;
+
+            resident_pixel_bytes -= pixels_size_in_bytes(avatar);
+            num_evicted_pixels++;
+
+            avatar->is_forgotten = !avatar->file_offset && !avatar->texture.texture_id;
+        }
+
+        index = next;
+    }
+}
+
+// Pixels are already counted in resident_pixel_bytes
+static s32 add_avatar_to_memory_cache(u64 url_hash, u8* pixels, u32 width, u32 height, u32 file_offset) {
+    s32 index = id_hash_map_get(&url_hash_to_cached_avatar, url_hash);
+
+    // Forgotten avatars which came from the network again keep their slot
+    if (index == -1) {
+        index = (s32) cached_avatars.length;
+
+        Cached_Avatar* avatar = lazy_array_reserve_n_values(cached_avatars, 1);
+        avatar->texture = {};
+        avatar->last_drawn_at = 0;
+        avatar->more_recently_drawn = -1;
+        avatar->less_recently_drawn = -1;
+        avatar->more_recently_used = -1;
+        avatar->less_recently_used = -1;
+
+        id_hash_map_put(&url_hash_to_cached_avatar, index, url_hash);
+    }
+
+    Cached_Avatar* avatar = &cached_avatars[index];
+    avatar->pixels = pixels;
+    avatar->width = width;
+    avatar->height = height;
+    avatar->file_offset = file_offset;
+    avatar->is_being_read = false;
+    avatar->is_forgotten = false;
+
+    if (pixels) {
+        link_as_most_recently_used(index);
+    }
+
+    return index;
+}
+
+// Runs on a worker
+static void write_cache_file(void*, u32) {
+    platform_write_file(avatar_cache_file_path, write_data, write_length, write_appends);
+
+    is_write_done = true;
+}
+
+static void start_write(char* data, u32 length, bool append) {
+    write_data = data;
+    write_length = length;
+    write_appends = append;
+
+    is_write_running = true;
+    is_write_done = false;
+
+    platform_run_job(write_cache_file, NULL);
+}
+
+static void start_new_cache_file() {
+    Avatar_Cache_File_Header header;
+    header.magic = avatar_cache_magic;
+    header.version = avatar_cache_version;
+
+    platform_write_file(avatar_cache_file_path, &header, sizeof(header), false);
+
+    cache_file_size = sizeof(header);
+    written_cache_file_size = cache_file_size;
+}
+
+// Only the records are kept, pixels are read from the file when the avatar is drawn
+void avatar_cache_process_file(char* content_or_null, u32 content_length) {
+    id_hash_map_init(&url_hash_to_cached_avatar);
+
+    finished_loading = true;
+
+    Avatar_Cache_File_Header* header = (Avatar_Cache_File_Header*) content_or_null;
+
+    bool is_valid =
+            content_or_null &&
+            content_length >= sizeof(Avatar_Cache_File_Header) &&
+            header->magic == avatar_cache_magic &&
+            header->version == avatar_cache_version;
+
+    if (!is_valid) {
+        if (content_or_null) {
+            FREE(content_or_null);
+        }
+
+        start_new_cache_file();
+
+        return;
+    }
+
+    u64 start_time = platform_get_app_time_precise();
+
+    char* cursor = content_or_null + sizeof(Avatar_Cache_File_Header);
+    char* end = content_or_null + content_length;
+
+    // Only builds without the size limit wrote bigger files, whatever is past the limit is dropped
+    end = MIN(end, content_or_null + avatar_cache_max_file_size);
+
+    while (end - cursor >= (s64) sizeof(Avatar_Cache_Record)) {
+        Avatar_Cache_Record record;
+        memcpy(&record, cursor, sizeof(record));
+
+        u32 pixels_size = record.width * record.height * 4;
+
+        // Last record could have been cut off by an app crash while writing
+        if (end - cursor - sizeof(Avatar_Cache_Record) < pixels_size) {
+            break;
+        }
+
+        cursor += sizeof(Avatar_Cache_Record);
+
+        add_avatar_to_memory_cache(record.url_hash, NULL, record.width, record.height, (u32) (cursor - content_or_null));
+
+        cursor += pixels_size;
+    }
+
+    cache_file_size = (u32) (cursor - content_or_null);
+
+    // Appending after a cut off record would shift every record after it, so the file is cut there first.
+    //  Nothing can be read back while the file is being rewritten
+    if (cursor != content_or_null + content_length) {
+        rewritten_file_content = content_or_null;
+
+        start_write(content_or_null, cache_file_size, false);
+    } else {
+        written_cache_file_size = cache_file_size;
+
+        FREE(content_or_null);
+    }
+
+    printf("Loaded %i avatars from disk cache in %.3fms\n", cached_avatars.length, platform_get_delta_time_ms(start_time));
+}
+
+bool avatar_cache_finished_loading() {
+    return finished_loading;
+}
+
+// Box filter, good enough for photos which are only ever drawn at small sizes
+static void downscale_rgba(u8* source, u32 source_width, u32 source_height, u8* target, u32 target_width, u32 target_height) {
+    for (u32 y = 0; y < target_height; y++) {
+        u32 source_y_start = y * source_height / target_height;
+        u32 source_y_end = MAX(source_y_start + 1, (y + 1) * source_height / target_height);
+
+        for (u32 x = 0; x < target_width; x++) {
+            u32 source_x_start = x * source_width / target_width;
+            u32 source_x_end = MAX(source_x_start + 1, (x + 1) * source_width / target_width);
+
+            u32 sum[4] = { 0, 0, 0, 0 };
+
+            for (u32 source_y = source_y_start; source_y < source_y_end; source_y++) {
+                u8* source_pixel = source + (source_y * source_width + source_x_start) * 4;
+
+                for (u32 source_x = source_x_start; source_x < source_x_end; source_x++, source_pixel += 4) {
+                    sum[0] += source_pixel[0];
+                    sum[1] += source_pixel[1];
+                    sum[2] += source_pixel[2];
+                    sum[3] += source_pixel[3];
+                }
+            }
+
+            u32 samples = (source_y_end - source_y_start) * (source_x_end - source_x_start);
+            u8* target_pixel = target + (y * target_width + x) * 4;
+
+            target_pixel[0] = (u8) (sum[0] / samples);
+            target_pixel[1] = (u8) (sum[1] / samples);
+            target_pixel[2] = (u8) (sum[2] / samples);
+            target_pixel[3] = (u8) (sum[3] / samples);
+        }
+    }
+}
+
+bool avatar_cache_take_forgotten(u64 url_hash) {
+    s32 index = id_hash_map_get(&url_hash_to_cached_avatar, url_hash);
+
+    if (index == -1 || !cached_avatars[index].is_forgotten) {
+        return false;
+    }
+
+    cached_avatars[index].is_forgotten = false;
+
+    return true;
+}
+
+void avatar_cache_put(u64 url_hash, u8* pixels, u32 width, u32 height) {
+    u32 longest_side = MAX(width, height);
+    u32 target_width = width;
+    u32 target_height = height;
+
+    if (longest_side > avatar_cache_max_side) {
+        target_width = MAX(1, width * avatar_cache_max_side / longest_side);
+        target_height = MAX(1, height * avatar_cache_max_side / longest_side);
+    }
+
+    s32 existing = id_hash_map_get(&url_hash_to_cached_avatar, url_hash);
+
+    // Both users and suggested users can request the same avatar, only forgotten ones are put again
+    if (existing != -1) {
+        Cached_Avatar* avatar = &cached_avatars[existing];
+
+        if (avatar->pixels || avatar->file_offset || avatar->is_being_read || avatar->texture.texture_id) {
+            return;
+        }
+    }
+
+    u32 pixels_size = target_width * target_height * 4;
+
+    Memory_Tag previous_tag = set_memory_tag(Memory_Tag_Images);
+
+    evict_pixels_to_fit(pixels_size);
+
+    u8* target_pixels = (u8*) MALLOC(pixels_size);
+
+    if (target_width == width && target_height == height) {
+        memcpy(target_pixels, pixels, pixels_size);
+    } else {
+        downscale_rgba(pixels, width, height, target_pixels, target_width, target_height);
+    }
+
+    resident_pixel_bytes += pixels_size;
+
+    u32 record_size = sizeof(Avatar_Cache_Record) + pixels_size;
+    u32 file_offset = 0;
+
+    if (cache_file_size + record_size <= avatar_cache_max_file_size) {
+        if (pending_appends_length + record_size > pending_appends_watermark) {
+            pending_appends_watermark = MAX(pending_appends_watermark * 2, MAX(pending_appends_length + record_size, avatar_cache_write_batch_size));
+            pending_appends = (char*) REALLOC(pending_appends, pending_appends_watermark);
+        }
+
+        // Padding goes to disk too
+        Avatar_Cache_Record record;
+        memset(&record, 0, sizeof(record));
+        record.url_hash = url_hash;
+        record.width = (u16) target_width;
+        record.height = (u16) target_height;
+
+        if (!pending_appends_length) {
+            first_pending_append_at = platform_get_app_time_precise();
+        }
+
+        char* append_to = pending_appends + pending_appends_length;
+
+        memcpy(append_to, &record, sizeof(record));
+        memcpy(append_to + sizeof(record), target_pixels, pixels_size);
+
+        file_offset = cache_file_size + sizeof(record);
+
+        pending_appends_length += record_size;
+        cache_file_size += record_size;
+    }
+
+    add_avatar_to_memory_cache(url_hash, target_pixels, target_width, target_height, file_offset);
+
+    set_memory_tag(previous_tag);
+}
+
+// Runs on a worker
+static void read_avatars_from_cache_file(void*, u32) {
+    for (u32 read_index = 0; read_index < reads_running_length; read_index++) {
+        Avatar_Read& read = reads_running[read_index];
+
+        read.succeeded = platform_read_file_range(avatar_cache_file_path, read.file_offset, read.pixels, read.size);
+    }
+
+    is_read_done = true;
+}
+
+// A failed read means the file changed under us, so the avatar is forgotten and comes from the network again
+static void finish_reads_if_done() {
+    if (!is_read_running || !is_read_done) {
+        return;
+    }
+
+    is_read_running = false;
+
+    for (u32 read_index = 0; read_index < reads_running_length; read_index++) {
+        Avatar_Read& read = reads_running[read_index];
+        Cached_Avatar* avatar = &cached_avatars[read.avatar];
+
+        avatar->is_being_read = false;
+
+        if (read.succeeded) {
+            avatar->pixels = read.pixels;
+
+            link_as_most_recently_used(read.avatar);
+        } else {
+            FREE(read.pixels);
+
+            avatar->file_offset = 0;
+            avatar->is_forgotten = true;
+            resident_pixel_bytes -= read.size;
+        }
+    }
+
+    reads_running_length = 0;
+}
+
+static void start_reads_if_necessary() {
+    if (is_read_running || !pending_reads_length) {
+        return;
+    }
+
+    Avatar_Read* reads = pending_reads;
+    u32 reads_watermark = pending_reads_watermark;
+
+    pending_reads = reads_running;
+    pending_reads_watermark = reads_running_watermark;
+
+    reads_running = reads;
+    reads_running_length = pending_reads_length;
+    reads_running_watermark = reads_watermark;
+
+    pending_reads_length = 0;
+
+    is_read_running = true;
+    is_read_done = false;
+
+    num_pixel_reads += reads_running_length;
+
+    platform_run_job(read_avatars_from_cache_file, NULL);
+}
+
+static void queue_read(s32 index) {
+    Cached_Avatar* avatar = &cached_avatars[index];
+    u32 size = pixels_size_in_bytes(avatar);
+
+    Memory_Tag previous_tag = set_memory_tag(Memory_Tag_Images);
+
+    evict_pixels_to_fit(size);
+
+    if (pending_reads_length == pending_reads_watermark) {
+        pending_reads_watermark = MAX(pending_reads_watermark * 2, 32);
+        pending_reads = (Avatar_Read*) REALLOC(pending_reads, sizeof(Avatar_Read) * pending_reads_watermark);
+    }
+
+    Avatar_Read& read = pending_reads[pending_reads_length++];
+    read.avatar = index;
+    read.file_offset = avatar->file_offset;
+    read.size = size;
+    read.pixels = (u8*) MALLOC(size);
+    read.succeeded = false;
+
+    set_memory_tag(previous_tag);
+
+    avatar->is_being_read = true;
+    resident_pixel_bytes += size;
+}
+
+void update_avatar_cache() {
+    finish_reads_if_done();
+    start_reads_if_necessary();
+
+    if (is_write_running) {
+        if (!is_write_done) {
+            return;
+        }
+
+        is_write_running = false;
+
+        if (rewritten_file_content) {
+            FREE(rewritten_file_content);
+            rewritten_file_content = NULL;
+
+            written_cache_file_size = write_length;
+        } else {
+            written_cache_file_size += write_length;
+        }
+    }
+
+    bool should_write =
+            pending_appends_length >= avatar_cache_write_batch_size ||
+            (pending_appends_length && platform_get_delta_time_ms(first_pending_append_at) >= avatar_cache_write_delay_ms);
+
+    if (!should_write) {
+        return;
+    }
+
+    char* appends = pending_appends;
+    u32 appends_watermark = pending_appends_watermark;
+
+    pending_appends = appends_being_written;
+    pending_appends_watermark = appends_being_written_watermark;
+
+    appends_being_written = appends;
+    appends_being_written_length = pending_appends_length;
+    appends_being_written_watermark = appends_watermark;
+
+    pending_appends_length = 0;
+
+    start_write(appends_being_written, appends_being_written_length, true);
+}
+
+static void unlink_from_lru_list(Cached_Avatar* avatar) {
+    if (avatar->more_recently_drawn != -1) {
+        cached_avatars[avatar->more_recently_drawn].less_recently_drawn = avatar->less_recently_drawn;
+    } else {
+        most_recently_drawn = avatar->less_recently_drawn;
+    }
+
+    if (avatar->less_recently_drawn != -1) {
+        cached_avatars[avatar->less_recently_drawn].more_recently_drawn = avatar->more_recently_drawn;
+    } else {
+        least_recently_drawn = avatar->more_recently_drawn;
+    }
+
+    avatar->more_recently_drawn = -1;
+    avatar->less_recently_drawn = -1;
+}
+
+static void link_as_most_recently_drawn(s32 index) {
+    Cached_Avatar* avatar = &cached_avatars[index];
+    avatar->more_recently_drawn = -1;
+    avatar->less_recently_drawn = most_recently_drawn;
+
+    if (most_recently_drawn != -1) {
+        cached_avatars[most_recently_drawn].more_recently_drawn = index;
+    } else {
+        least_recently_drawn = index;
+    }
+
+    most_recently_drawn = index;
+}
+
+static void evict_textures_to_fit(u32 bytes_needed) {
+    while (least_recently_drawn != -1 && resident_texture_bytes + bytes_needed > avatar_texture_budget_bytes) {
+        Cached_Avatar* avatar = &cached_avatars[least_recently_drawn];
+
+        // Draw lists referencing this frame's textures haven't been rendered yet,
+        //  if everything resident was drawn this frame we just go over the budget
+        if (avatar->last_drawn_at == tick) {
+            break;
+        }
+
+        unlink_from_lru_list(avatar);
+        unload_image_from_gpu_memory(avatar->texture);
+
+        avatar->is_forgotten = !avatar->pixels && !avatar->file_offset;
+
+        resident_texture_bytes -= pixels_size_in_bytes(avatar);
+        num_resident_textures--;
+        num_evicted_textures++;
+    }
+}
+
+u32 avatar_cache_get_texture_for_drawing(u64 url_hash) {
+    s32 index = id_hash_map_get(&url_hash_to_cached_avatar, url_hash);
+
+    if (index == -1) {
+        return 0;
+    }
+
+    Cached_Avatar* avatar = &cached_avatars[index];
+
+    if (avatar->last_drawn_at == tick && avatar->texture.texture_id) {
+        return avatar->texture.texture_id;
+    }
+
+    if (avatar->texture.texture_id) {
+        unlink_from_lru_list(avatar);
+    } else if (avatar->pixels) {
+        u32 size_in_bytes = pixels_size_in_bytes(avatar);
+
+        evict_textures_to_fit(size_in_bytes);
+
+        avatar->texture.width = avatar->width;
+        avatar->texture.height = avatar->height;
+
+        load_image_into_gpu_memory(avatar->texture, avatar->pixels);
+
+        resident_texture_bytes += size_in_bytes;
+        num_resident_textures++;
+
+        unlink_from_pixels_lru_list(avatar);
+        link_as_most_recently_used(index);
+    } else {
+        // Appends which are still on their way to the file just have to wait for the write
+        if (!avatar->is_being_read && can_be_read_back(avatar)) {
+            queue_read(index);
+        }
+
+        return 0;
+    }
+
+    avatar->last_drawn_at = tick;
+
+    link_as_most_recently_drawn(index);
+
+    return avatar->texture.texture_id;
+}
+
+void draw_avatar_cache_debug_info() {
+    ImGui::Text("Avatars cached: %i, textures resident: %i, evicted: %i", cached_avatars.length, num_resident_textures, num_evicted_textures);
+    ImGui::Text("Avatar textures: %.2fkb/%.2fkb", resident_texture_bytes / 1024.0f, avatar_texture_budget_bytes / 1024.0f);
+    ImGui::Text("Avatar pixels: %.2fkb/%.2fkb, evicted: %i, read back from disk: %i",
+                resident_pixel_bytes / 1024.0f, avatar_pixel_budget_bytes / 1024.0f, num_evicted_pixels, num_pixel_reads);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "common.h"
+
+/**
+ * Decoded avatar pixels, keyed by XXH64 of the avatar url.
+ *
+ * Pixels are downscaled to at most avatar_cache_max_side on the longest side before they are stored,
+ * both in memory and in an append-only file on disk of at most avatar_cache_max_file_size,
+ *  which is read asynchronously on startup.
+ * This way avatars which were seen at least once never go through the network + PNG decoding again.
+ *
+ * Textures are created lazily from those pixels when an avatar is drawn and are kept within
+ *  avatar_texture_budget_bytes, least recently drawn textures get deleted first.
+ * Pixels are kept within avatar_pixel_budget_bytes the same way. Avatars in the file are read back from it
+ *  when they are drawn again, the ones which didn't fit into the file are forgotten.
+ */
+
+extern const char* avatar_cache_file_path;
+extern u32 avatar_texture_budget_bytes;
+extern u32 avatar_pixel_budget_bytes;
+
+inline u64 hash_avatar_url(String& url) {
+    return XXH64(url.start, url.length, hash_seed);
+}
+
+void avatar_cache_process_file(char* content_or_null, u32 content_length);
+bool avatar_cache_finished_loading();
+void avatar_cache_put(u64 url_hash, u8* pixels, u32 width, u32 height);
+
+// True once for every forgotten avatar, so it's requested from the network again only once
+bool avatar_cache_take_forgotten(u64 url_hash);
+
+// Finishes and starts reads and writes of the cache file. Called once per frame
+void update_avatar_cache();
+
+// Returns 0 if the avatar is not cached yet or is being read from disk, marks texture as drawn this tick otherwise
+u32 avatar_cache_get_texture_for_drawing(u64 url_hash);
+
+void draw_avatar_cache_debug_info();
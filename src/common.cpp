@@ -89,6 +89,14 @@ void load_image_into_gpu_memory(Memory_Image& image, void* pixels) {
     image.texture_id = texture_id;
 }
 
+void unload_image_from_gpu_memory(Memory_Image& image) {
+    GLuint texture_id = image.texture_id;
+
+    glDeleteTextures(1, &texture_id);
+
+    image.texture_id = 0;
+}
+
 bool load_png_from_disk(const char* path, Memory_Image& out) {
     unsigned char *data;
     unsigned error = lodepng_decode32_file(&data, &out.width, &out.height, path);
@@ -2,13 +2,35 @@
 #include "xxhash.h"
 #include "base32.h"
 #include <stdio.h>
+#include <stdlib.h>
 
 #pragma once
 
+// Selected with -DMEMORY_TRACING=RAW|SAMPLED|FULL in cmake
+#define MEMORY_TRACING_RAW 0
+#define MEMORY_TRACING_SAMPLED 1
+#define MEMORY_TRACING_FULL 2
+
+#ifndef MEMORY_TRACING
+#define MEMORY_TRACING MEMORY_TRACING_FULL
+#endif
+
+// Every Nth allocation is recorded, along with its call stack
+#ifndef MEMORY_TRACING_SAMPLE_RATE
+#define MEMORY_TRACING_SAMPLE_RATE 64
+#endif
+
+#if MEMORY_TRACING == MEMORY_TRACING_RAW
+#define MALLOC(x) malloc(x)
+#define CALLOC(x, y) calloc(x, y)
+#define REALLOC(x, y) realloc(x, y)
+#define FREE(x) free(x)
+#else
 #define MALLOC(x) malloc_and_log(__FILE__, __FUNCTION__, __LINE__, x)
 #define CALLOC(x, y) calloc_and_log(__FILE__, __FUNCTION__, __LINE__, x, y)
 #define REALLOC(x, y) realloc_and_log(__FILE__, __FUNCTION__, __LINE__, x, y)
 #define FREE(x) free_and_log(__FILE__, __FUNCTION__, __LINE__, x)
+#endif
 
 #define PRINTLIKE(string_index, first_to_check) __attribute__((__format__ (__printf__, string_index, first_to_check)))
 
@@ -23,17 +45,44 @@ typedef short s16;
 
 typedef s32 Request_Id;
 
-// TODO strong typedefs?
-// TODO hash could be optionally contained within the ID
-typedef s32 Account_Id;
-typedef s32 Folder_Id;
-typedef s32 Task_Id;
-typedef s32 Custom_Field_Id;
-typedef s32 Custom_Status_Id;
-typedef s32 Workflow_Id;
-typedef s32 User_Id;
-typedef s32 Comment_Id;
-typedef s32 Inbox_Notification_Id;
+/**
+ * Ids of different kinds don't convert into each other, Kind is only a tag and is never instantiated.
+ * Hash is computed once when the id is made with make_id, hash maps and entity registries use it as is.
+ * Zeroed memory is a valid empty id, like before, but only make_id produces a correct hash.
+ */
+template <typename Kind>
+struct Id {
+    s32 value;
+    u32 hash;
+
+    bool operator ==(const Id<Kind>& other) const {
+        return value == other.value;
+    }
+
+    bool operator !=(const Id<Kind>& other) const {
+        return value != other.value;
+    }
+};
+
+struct Account;
+struct Folder;
+struct Task;
+struct Custom_Field;
+struct Custom_Status;
+struct Workflow;
+struct User;
+struct Task_Comment;
+struct Inbox_Notification;
+
+typedef Id<Account> Account_Id;
+typedef Id<Folder> Folder_Id;
+typedef Id<Task> Task_Id;
+typedef Id<Custom_Field> Custom_Field_Id;
+typedef Id<Custom_Status> Custom_Status_Id;
+typedef Id<Workflow> Workflow_Id;
+typedef Id<User> User_Id;
+typedef Id<Task_Comment> Comment_Id;
+typedef Id<Inbox_Notification> Inbox_Notification_Id;
 
 enum string_to_int_error {
     STR2INT_SUCCESS,
@@ -95,6 +144,7 @@ inline float lerp(float time_from, float time_to, float scale_to, float max) {
 }
 
 void load_image_into_gpu_memory(Memory_Image& image, void* pixels);
+void unload_image_from_gpu_memory(Memory_Image& image);
 bool load_png_from_disk(const char* path, Memory_Image& out);
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
@@ -117,8 +167,26 @@ inline u32 hash_string(String& string) {
     return XXH32(string.start, string.length, hash_seed);
 }
 
+// Murmur3 finalizer, a whole XXH32 is overkill for 4 bytes and ids are hashed on every lookup
 inline u32 hash_id(s32 id) {
-    return XXH32(&id, sizeof(id), hash_seed);
+    u32 hash = (u32) id ^ hash_seed;
+
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
+
+    return hash;
+}
+
+template <typename Kind>
+inline Id<Kind> make_id(s32 value) {
+    Id<Kind> id;
+    id.value = value;
+    id.hash = hash_id(value);
+
+    return id;
 }
 
 inline s32 uchars_to_s32(const u8* chars) {
@@ -128,30 +196,37 @@ inline s32 uchars_to_s32(const u8* chars) {
             ((chars[3] & 0xff)      ));
 }
 
-inline void fill_id8(const u8 type, s32 id, u8* output) {
+template <typename Kind>
+inline void fill_id8(const u8 type, Id<Kind> id, u8* output) {
+    s32 value = id.value;
+
     u8 input[] = {
             type,
-            (u8) (id >> 24),
-            (u8) (id >> 16),
-            (u8) (id >> 8),
-            (u8) id
+            (u8) (value >> 24),
+            (u8) (value >> 16),
+            (u8) (value >> 8),
+            (u8) value
     };
 
     base32_encode(input, ARRAY_SIZE(input), output);
 }
 
-inline void fill_id16(const u8 type1, s32 id1, const u8 type2, s32 id2, u8* output) {
+template <typename Kind1, typename Kind2>
+inline void fill_id16(const u8 type1, Id<Kind1> id1, const u8 type2, Id<Kind2> id2, u8* output) {
+    s32 value1 = id1.value;
+    s32 value2 = id2.value;
+
     u8 input[] = {
             type1,
-            (u8) (id1 >> 24),
-            (u8) (id1 >> 16),
-            (u8) (id1 >> 8),
-            (u8) id1,
+            (u8) (value1 >> 24),
+            (u8) (value1 >> 16),
+            (u8) (value1 >> 8),
+            (u8) value1,
             type2,
-            (u8) (id2 >> 24),
-            (u8) (id2 >> 16),
-            (u8) (id2 >> 8),
-            (u8) id2
+            (u8) (value2 >> 24),
+            (u8) (value2 >> 16),
+            (u8) (value2 >> 8),
+            (u8) value2
     };
 
     base32_encode(input, ARRAY_SIZE(input), output);
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstring>
+#include "common.h"
+#include "id_hash_map.h"
+#include "lazy_array.h"
+
+/**
+ * Dense indices for sparse Wrike ids.
+ *
+ * An id gets the next index the first time it's registered, by whoever sees it first: a task which
+ *  references a user before users are loaded registers that user. Relations are stored as indices, so
+ *  resolving them on draw and sort is indexing into entities instead of hashing the id.
+ *
+ * Indices stay valid across reloads, a reload only replaces what entities point to. Owners which drop
+ *  entities nobody refers to anymore (see entity_store_remove) make their indices free for ids registered
+ *  later, so whoever drops them has to know every place which holds such indices.
+ * Index 0 is never handed out, so zeroed memory reads as NO_ENTITY.
+ *
+ * Each entity has a version which owners bump with entity_touch when the entity changes, views remember
+ *  the version they've built their state from. total_version changes with any entity, so views can skip
+ *  checking their entities one by one when nothing changed at all.
+ *
+ * Kind is the kind of id, it's only different from T when the stored struct isn't the entity itself.
+ */
+
+typedef u32 Entity_Index;
+
+static const Entity_Index NO_ENTITY = 0;
+
+template <typename T, typename Kind = T>
+struct Entity_Registry {
+    Id_Hash_Map<Id<Kind>, Entity_Index, NO_ENTITY> id_to_index{};
+    T** entities = NULL; // NULL until the owner of T has loaded it
+    u32* versions = NULL;
+    u32 length = 0;
+    u32 watermark = 0;
+    u32 total_version = 0;
+
+    Lazy_Array<Entity_Index, 64> free_indices{};
+};
+
+// Registry which owns its entities, they are stored in blocks so pointers to them stay valid until removed
+template <typename T, typename Kind = T>
+struct Entity_Store {
+    Entity_Registry<T, Kind> registry{};
+    Block_Array<T, 256> values{};
+    Lazy_Array<T*, 64> free_values{}; // Removed values are zeroed and handed out again first
+};
+
+template <typename T, typename Kind>
+Entity_Index entity_register(Entity_Registry<T, Kind>& registry, Id<Kind> id) {
+    Entity_Index index = id_hash_map_get(&registry.id_to_index, id);
+
+    if (index != NO_ENTITY) {
+        return index;
+    }
+
+    // Versions of a reused index keep counting up, so a view which still remembers the old entity sees a change
+    if (registry.free_indices.length) {
+        index = registry.free_indices[--registry.free_indices.length];
+
+        registry.entities[index] = NULL;
+
+        id_hash_map_put(&registry.id_to_index, index, id);
+
+        return index;
+    }
+
+    if (!registry.length) {
+        registry.length = 1;
+    }
+
+    if (registry.length >= registry.watermark) {
+        bool is_first_allocation = registry.entities == NULL;
+
+        registry.watermark = MAX(registry.watermark * 2, 64);
+        registry.entities = (T**) REALLOC(registry.entities, sizeof(T*) * registry.watermark);
+        registry.versions = (u32*) REALLOC(registry.versions, sizeof(u32) * registry.watermark);
+
+        // Lookups of NO_ENTITY are inside length, so they have to find nothing there
+        if (is_first_allocation) {
+            registry.entities[NO_ENTITY] = NULL;
+            registry.versions[NO_ENTITY] = 0;
+        }
+    }
+
+    index = registry.length++;
+
+    registry.entities[index] = NULL;
+    registry.versions[index] = 0;
+
+    id_hash_map_put(&registry.id_to_index, index, id);
+
+    return index;
+}
+
+// Doesn't register, NO_ENTITY if the id was never seen
+template <typename T, typename Kind>
+inline Entity_Index entity_find(Entity_Registry<T, Kind>& registry, Id<Kind> id) {
+    return id_hash_map_get(&registry.id_to_index, id);
+}
+
+template <typename T, typename Kind>
+inline T* entity_get(Entity_Registry<T, Kind>& registry, Entity_Index index) {
+    return index < registry.length ? registry.entities[index] : NULL;
+}
+
+template <typename T, typename Kind>
+inline void entity_touch(Entity_Registry<T, Kind>& registry, Entity_Index index) {
+    registry.versions[index]++;
+    registry.total_version++;
+}
+
+template <typename T, typename Kind>
+inline void entity_set(Entity_Registry<T, Kind>& registry, Entity_Index index, T* entity) {
+    registry.entities[index] = entity;
+
+    entity_touch(registry, index);
+}
+
+template <typename T, typename Kind>
+inline u32 entity_version(Entity_Registry<T, Kind>& registry, Entity_Index index) {
+    return index < registry.length ? registry.versions[index] : 0;
+}
+
+// Has to be called before the storage entities point into is reallocated or refilled
+template <typename T, typename Kind>
+void entity_registry_forget_entities(Entity_Registry<T, Kind>& registry) {
+    if (registry.length) {
+        memset(registry.entities, 0, sizeof(T*) * registry.length);
+    }
+}
+
+// New entities are zeroed, so out_is_new is there for the callers which need to set up more than that
+template <typename T, typename Kind>
+T* entity_store_get_or_add(Entity_Store<T, Kind>& store, Id<Kind> id, Entity_Index& out_index, bool& out_is_new) {
+    out_index = entity_register(store.registry, id);
+
+    T* entity = entity_get(store.registry, out_index);
+
+    out_is_new = entity == NULL;
+
+    if (out_is_new) {
+        if (store.free_values.length) {
+            entity = store.free_values[--store.free_values.length];
+        } else {
+            entity = block_array_reserve_n_values(store.values, 1);
+        }
+
+        *entity = {};
+
+        entity_set(store.registry, out_index, entity);
+    }
+
+    return entity;
+}
+
+// Nothing may refer to the index afterwards, it goes to the next id which gets registered
+template <typename T, typename Kind>
+void entity_store_remove(Entity_Store<T, Kind>& store, Id<Kind> id, Entity_Index index) {
+    T* entity = entity_get(store.registry, index);
+
+    assert(entity);
+
+    *entity = {};
+
+    *lazy_array_reserve_n_values(store.free_values, 1) = entity;
+    *lazy_array_reserve_n_values(store.registry.free_indices, 1) = index;
+
+    id_hash_map_remove(&store.registry.id_to_index, id);
+
+    store.registry.entities[index] = NULL;
+
+    entity_touch(store.registry, index);
+}
@@ -7,6 +7,7 @@
 #include "platform.h"
 #include "ui.h"
 #include "renderer.h"
+#include "interned_strings.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -35,25 +36,7 @@
  *      comes in.
  */
 
-struct Folder_Handle {
-    s32 value;
-
-    Folder_Handle(){};
-
-    explicit Folder_Handle(s32 v) : value(v) {};
-
-    explicit operator s32() const {
-        return value;
-    }
-
-    bool operator ==(const Folder_Handle& handle) const {
-        return value == handle.value;
-    }
-
-    bool operator !=(const Folder_Handle& handle) const {
-        return value != handle.value;
-    }
-};
+typedef Handle<Folder_Tree_Node> Folder_Handle;
 
 struct Parent_Child_Pair {
     Folder_Handle parent;
@@ -69,47 +52,51 @@ struct Flattened_Folder_Node {
     Folder_Handle source; // TODO could be a pointer since we are rebuilding flattened_tree on changes anyway?
 };
 
-const Folder_Handle NULL_FOLDER_HANDLE(-1);
+const Folder_Handle NULL_FOLDER_HANDLE{};
 
 static Lazy_Array<Flattened_Folder_Node, 64> flattened_folder_tree{};
 static Lazy_Array<Parent_Child_Pair, 64> parent_child_pairs{};
-// We can't use Id_Hash_Map<Folder_Id, Folder_Handle, NULL_FOLDER_HANDLE> because C++ reasons
-static Id_Hash_Map<Folder_Id, s32, -1> folder_id_to_handle_map{};
+// We can't use Id_Hash_Map<Folder_Id, Folder_Handle, NULL_FOLDER_HANDLE> because C++ reasons, so raw handle values it is
+static Id_Hash_Map<Folder_Id, u32, 0> folder_id_to_handle_map{};
 
 static char search_buffer[128];
 
 Folder_Handle root_node = NULL_FOLDER_HANDLE;
-Array<Folder_Tree_Node> all_nodes{};
+Pool<Folder_Tree_Node> all_nodes{};
 
 Array<Folder> starred_folders{};
 Array<Folder> suggested_folders{};
 Array<Folder_Tree_Node*> folder_tree_search_result{};
 
 inline Folder_Tree_Node* get_folder_node_by_handle(Folder_Handle handle) {
-    return all_nodes.data + (s32) handle;
+    Folder_Tree_Node* node = pool_get(all_nodes, handle);
+
+    assert(node);
+
+    return node;
 }
 
-inline Folder_Handle get_handle_by_folder_id(Folder_Id folder_id, u32 id_hash) {
-    return Folder_Handle(id_hash_map_get(&folder_id_to_handle_map, folder_id, id_hash));
+inline Folder_Handle get_handle_by_folder_id(Folder_Id folder_id) {
+    Folder_Handle handle;
+    handle.value = id_hash_map_get(&folder_id_to_handle_map, folder_id);
+
+    return handle;
 }
 
-static Folder_Handle get_or_push_folder_node(Folder_Id folder_id, u32 id_hash) {
-    Folder_Handle handle = get_handle_by_folder_id(folder_id, id_hash);
+static Folder_Handle get_or_push_folder_node(Folder_Id folder_id) {
+    Folder_Handle handle = get_handle_by_folder_id(folder_id);
 
     if (handle != NULL_FOLDER_HANDLE) {
         return handle;
     }
 
-    Folder_Handle new_handle = Folder_Handle(all_nodes.length);
-    Folder_Tree_Node* new_node = get_folder_node_by_handle(new_handle);
+    Folder_Handle new_handle;
+    Folder_Tree_Node* new_node = pool_add(all_nodes, new_handle);
     new_node->id = folder_id;
-    new_node->id_hash = id_hash;
     new_node->num_children = 0;
     new_node->children_loaded = false;
 
-    id_hash_map_put(&folder_id_to_handle_map, (s32) new_handle, new_node->id, new_node->id_hash);
-
-    all_nodes.length++;
+    id_hash_map_put(&folder_id_to_handle_map, new_handle.value, new_node->id);
 
     return new_handle;
 }
@@ -118,7 +105,7 @@ static int compare_parent_child_pairs(const void* a, const void* b) {
     Parent_Child_Pair* pair_a = (Parent_Child_Pair*) a;
     Parent_Child_Pair* pair_b = (Parent_Child_Pair*) b;
 
-    int result = pair_a->parent.value - pair_b->parent.value;
+    int result = (pair_a->parent.value > pair_b->parent.value) - (pair_a->parent.value < pair_b->parent.value);
 
     if (result == 0) {
         // TODO might be slow
@@ -135,7 +122,7 @@ static int compare_folder_handle_with_parent_child_pair_parent(const void* key,
     Folder_Handle* key_handle = (Folder_Handle*) key;
     Parent_Child_Pair* value_pair = (Parent_Child_Pair*) value;
 
-    return key_handle->value - value_pair->parent.value;
+    return (key_handle->value > value_pair->parent.value) - (key_handle->value < value_pair->parent.value);
 }
 
 // TODO use the num_children param
@@ -530,7 +517,7 @@ void draw_folder_tree(float column_width) {
             Folder_Tree_Node* node = *node_pointer;
             char* name = string_to_temporary_null_terminated_string(node->name);
 
-            ImGui::PushID(node->id);
+            ImGui::PushID(node->id.value);
             if (ImGui::Selectable(name)) {
                 select_and_request_folder_by_id(node->id);
             }
@@ -572,30 +559,23 @@ void draw_folder_tree(float column_width) {
 void folder_tree_init(Folder_Id root_node_id) {
     id_hash_map_init(&folder_id_to_handle_map);
 
-    all_nodes.data = (Folder_Tree_Node*) REALLOC(all_nodes.data, sizeof(Folder_Tree_Node));
-
     static Folder_Color root_node_color(0, 0xff555555, 0);
 
-    root_node = get_or_push_folder_node(root_node_id, hash_id(root_node_id));
+    root_node = get_or_push_folder_node(root_node_id);
 
     Folder_Tree_Node* root = get_folder_node_by_handle(root_node);
     root->color = &root_node_color;
-    root->name.start = (char*) "Root"; // TODO use the string storage
-    root->name.length = strlen(root->name.start);
+    root->name = intern_string("Root", 4);
 }
 
-Folder_Tree_Node* find_folder_tree_node_by_id(Folder_Id id, u32 id_hash) {
-    if (!id_hash) {
-        id_hash = hash_id(id);
-    }
-
-    Folder_Handle handle = get_handle_by_folder_id(id, id_hash);
+Folder_Tree_Node* find_folder_tree_node_by_id(Folder_Id id) {
+    Folder_Handle handle = get_handle_by_folder_id(id);
 
     if (handle == NULL_FOLDER_HANDLE) {
         return NULL;
     }
 
-    return &all_nodes[(s32) handle];
+    return pool_get(all_nodes, handle);
 }
 
 static void try_add_parent_child_pair(Folder_Handle parent, Folder_Handle child) {
@@ -633,7 +613,7 @@ static void process_folder_tree_child_object(Folder_Handle parent_handle, char*
 
         // TODO string comparison there is inefficient, can be faster
         if (json_string_equals(json, property_token, "title")) {
-            json_token_to_string(json, value_token, folder_data.name);
+            json_token_to_interned_string(json, value_token, folder_data.name);
         } else if (json_string_equals(json, property_token, "id")) {
             json_token_to_right_part_of_id16(json, value_token, folder_data.id);
         } else if (json_string_equals(json, property_token, "color")) {
@@ -655,7 +635,7 @@ static void process_folder_tree_child_object(Folder_Handle parent_handle, char*
         }
     }
 
-    Folder_Handle new_handle = get_or_push_folder_node(folder_data.id, hash_id(folder_data.id));
+    Folder_Handle new_handle = get_or_push_folder_node(folder_data.id);
     Folder_Tree_Node* new_node = get_folder_node_by_handle(new_handle);
 
     new_node->name = folder_data.name;
@@ -672,11 +652,7 @@ void folder_tree_search(const char* query, Array<Folder_Tree_Node*>* result) {
 }
 
 void process_multiple_folders_data(char* json, u32 data_size, jsmntok_t*& token) {
-    u32 new_size = all_nodes.length + data_size;
-
-    if (all_nodes.length < new_size) {
-        all_nodes.data = (Folder_Tree_Node*) REALLOC(all_nodes.data, sizeof(Folder_Tree_Node) * new_size);
-    }
+    pool_reserve(all_nodes, data_size);
 
     for (u32 array_index = 0; array_index < data_size; array_index++) {
         process_folder_tree_child_object(NULL_FOLDER_HANDLE, json, token);
@@ -696,7 +672,7 @@ static void process_plain_folder_data_object(Folder* folder, char* json, jsmntok
         jsmntok_t* next_token = token;
 
         if (json_string_equals(json, property_token, "title")) {
-            json_token_to_string(json, next_token, folder->name);
+            json_token_to_interned_string(json, next_token, folder->name);
         } else if (json_string_equals(json, property_token, "id")) {
             json_token_to_right_part_of_id16(json, next_token, folder->id);
         } else if (json_string_equals(json, property_token, "color")) {
@@ -713,7 +689,7 @@ static void process_plain_folder_data_object(Folder* folder, char* json, jsmntok
 }
 
 void process_folder_tree_children_request(Folder_Id parent_id, char* json, jsmntok_t* tokens, u32 num_tokens) {
-    Folder_Handle parent_handle = get_handle_by_folder_id(parent_id, hash_id(parent_id));
+    Folder_Handle parent_handle = get_handle_by_folder_id(parent_id);
 
     if (parent_handle == NULL_FOLDER_HANDLE) {
         assert(!"Parent node not found");
@@ -729,11 +705,7 @@ void process_folder_tree_children_request(Folder_Id parent_id, char* json, jsmnt
 
             token++;
 
-            u32 new_size = all_nodes.length + next_token->size;
-
-            if (all_nodes.length < new_size) {
-                all_nodes.data = (Folder_Tree_Node*) REALLOC(all_nodes.data, sizeof(Folder_Tree_Node) * new_size);
-            }
+            pool_reserve(all_nodes, next_token->size);
 
             for (u32 array_index = 0; array_index < next_token->size; array_index++) {
                 process_folder_tree_child_object(parent_handle, json, token);
@@ -973,4 +945,18 @@ Folder_Color* string_to_folder_color(String string) {
     return &None;
 
 #undef char_at_to_index
-}
\ No newline at end of file
+}
+
+void keep_folder_tree_interned_strings() {
+    for (u32 index = 0; index < all_nodes.length; index++) {
+        keep_interned_string(all_nodes.values[index].name);
+    }
+
+    for (u32 index = 0; index < starred_folders.length; index++) {
+        keep_interned_string(starred_folders[index].name);
+    }
+
+    for (u32 index = 0; index < suggested_folders.length; index++) {
+        keep_interned_string(suggested_folders[index].name);
+    }
+}
@@ -2,6 +2,7 @@
 #include "jsmn.h"
 #include "json.h"
 #include "lazy_array.h"
+#include "handle_pool.h"
 
 #pragma once
 
@@ -24,7 +25,6 @@ struct Folder {
 };
 
 struct Folder_Tree_Node : Folder {
-    u32 id_hash;
     u32 finished_loading_children_at;
     u32 num_children;
     bool children_loaded;
@@ -39,8 +39,9 @@ void process_multiple_folders_data(char* json, u32 data_size, jsmntok_t*& token)
 
 void folder_tree_search(const char* query, Array<Folder_Tree_Node*>* result);
 
-Folder_Tree_Node* find_folder_tree_node_by_id(Folder_Id id, u32 id_hash = 0);
+Folder_Tree_Node* find_folder_tree_node_by_id(Folder_Id id);
+void keep_folder_tree_interned_strings();
 
-extern Array<Folder_Tree_Node> all_nodes;
+extern Pool<Folder_Tree_Node> all_nodes;
 
 extern Array<Folder> suggested_folders;
\ No newline at end of file
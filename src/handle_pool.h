@@ -0,0 +1,237 @@
+#include <cassert>
+#include <cstring>
+#include "common.h"
+#include "lazy_array.h"
+
+#pragma once
+
+/**
+ * Generational handles, as described in http://floooh.github.io/2018/06/17/handles-vs-pointers.html
+ *
+ * Pool<T> stores individual values. A Handle packs the index of a slot and the generation that slot had
+ *  when the value was added, removing a value bumps the slot generation so stale handles are detected
+ *  instead of silently pointing at whatever takes the slot later. Values are kept dense, so iterating
+ *  over values[0, length) touches nothing but live values.
+ *
+ * Range_Pool<T> hands out contiguous ranges of values which all die together on reset, like all the
+ *  assignees of all tasks in a folder. It only has one generation for the whole pool. Values are stored
+ *  in a Block_Array, a range longer than range_pool_block_size gets an allocation of its own.
+ * Pools which are never reset can release short ranges one by one instead, a released range is handed
+ *  out again to the next reservation of the same length. Free ranges are linked through their first value.
+ */
+
+static const u32 handle_index_bits = 22;
+static const u32 handle_index_mask = (1u << handle_index_bits) - 1;
+static const u32 handle_generation_mask = (1u << (32 - handle_index_bits)) - 1;
+
+static const u32 NO_FREE_SLOT = (u32) -1;
+
+// Value 0 is never a valid handle, since generations start at 1
+template <typename T>
+struct Handle {
+    u32 value = 0;
+
+    bool operator ==(const Handle<T>& handle) const {
+        return value == handle.value;
+    }
+
+    bool operator !=(const Handle<T>& handle) const {
+        return value != handle.value;
+    }
+};
+
+struct Pool_Slot {
+    u32 dense_index_or_next_free;
+    u32 generation;
+};
+
+template <typename T>
+struct Pool {
+    T* values = NULL;
+    u32* value_slots = NULL; // Slot of each dense value, needed to fix up the slot of a value moved by remove
+    Pool_Slot* slots = NULL;
+
+    u32 length = 0;
+    u32 num_slots = 0;
+    u32 watermark = 0;
+    u32 first_free_slot = NO_FREE_SLOT;
+};
+
+template <typename T>
+inline u32 handle_index(Handle<T> handle) {
+    return handle.value & handle_index_mask;
+}
+
+template <typename T>
+inline u32 handle_generation(Handle<T> handle) {
+    return handle.value >> handle_index_bits;
+}
+
+template <typename T>
+void pool_reserve(Pool<T>& pool, u32 n) {
+    u32 required = pool.num_slots + n;
+
+    if (required <= pool.watermark) {
+        return;
+    }
+
+    assert(required <= handle_index_mask);
+
+    pool.watermark = MAX(pool.watermark * 2, required);
+
+    pool.values = (T*) REALLOC(pool.values, sizeof(T) * pool.watermark);
+    pool.value_slots = (u32*) REALLOC(pool.value_slots, sizeof(u32) * pool.watermark);
+    pool.slots = (Pool_Slot*) REALLOC(pool.slots, sizeof(Pool_Slot) * pool.watermark);
+}
+
+template <typename T>
+T* pool_add(Pool<T>& pool, Handle<T>& out_handle) {
+    u32 slot_index = pool.first_free_slot;
+
+    if (slot_index != NO_FREE_SLOT) {
+        pool.first_free_slot = pool.slots[slot_index].dense_index_or_next_free;
+    } else {
+        pool_reserve(pool, 1);
+
+        slot_index = pool.num_slots++;
+        pool.slots[slot_index].generation = 1;
+    }
+
+    u32 dense_index = pool.length++;
+
+    Pool_Slot& slot = pool.slots[slot_index];
+    slot.dense_index_or_next_free = dense_index;
+
+    pool.value_slots[dense_index] = slot_index;
+
+    out_handle.value = (slot.generation << handle_index_bits) | slot_index;
+
+    return &pool.values[dense_index];
+}
+
+// NULL for stale handles, pointer is only valid until the next add/remove
+template <typename T>
+inline T* pool_get(Pool<T>& pool, Handle<T> handle) {
+    u32 slot_index = handle_index(handle);
+
+    if (slot_index >= pool.num_slots) {
+        return NULL;
+    }
+
+    Pool_Slot& slot = pool.slots[slot_index];
+
+    if (slot.generation != handle_generation(handle)) {
+        return NULL;
+    }
+
+    return &pool.values[slot.dense_index_or_next_free];
+}
+
+template <typename T>
+void pool_remove(Pool<T>& pool, Handle<T> handle) {
+    u32 slot_index = handle_index(handle);
+
+    if (!pool_get(pool, handle)) {
+        assert(!"Removing a value by a stale handle");
+        return;
+    }
+
+    Pool_Slot& slot = pool.slots[slot_index];
+    u32 dense_index = slot.dense_index_or_next_free;
+    u32 last_dense_index = --pool.length;
+
+    // Last value takes the place of the removed one to keep values dense
+    if (dense_index != last_dense_index) {
+        u32 moved_slot_index = pool.value_slots[last_dense_index];
+
+        pool.values[dense_index] = pool.values[last_dense_index];
+        pool.value_slots[dense_index] = moved_slot_index;
+        pool.slots[moved_slot_index].dense_index_or_next_free = dense_index;
+    }
+
+    slot.generation = (slot.generation + 1) & handle_generation_mask;
+
+    if (!slot.generation) {
+        slot.generation = 1;
+    }
+
+    slot.dense_index_or_next_free = pool.first_free_slot;
+    pool.first_free_slot = slot_index;
+}
+
+template <typename T>
+struct Range_Handle {
+    u32 offset;
+    u32 length;
+    u32 generation;
+};
+
+static const u32 range_pool_block_size = 1024;
+static const u32 range_pool_max_released_length = 16;
+
+template <typename T>
+struct Range_Pool {
+    static_assert(sizeof(T) >= sizeof(u32), "Released ranges keep the next free offset in their first value");
+
+    Block_Array<T, range_pool_block_size> values{};
+    u32 generation = 1;
+
+    // Offset + 1 of the first released range of each length, 0 when there is none
+    u32 first_released[range_pool_max_released_length]{};
+};
+
+template <typename T>
+Range_Handle<T> range_pool_reserve(Range_Pool<T>& pool, u32 n) {
+    Range_Handle<T> handle;
+    handle.length = n;
+    handle.generation = pool.generation;
+
+    if (n < range_pool_max_released_length && pool.first_released[n]) {
+        handle.offset = pool.first_released[n] - 1;
+
+        memcpy(&pool.first_released[n], &pool.values[handle.offset], sizeof(u32));
+    } else {
+        handle.offset = block_array_reserve_n_values_and_get_offset(pool.values, n);
+    }
+
+    return handle;
+}
+
+// Handle length has to be the whole length the range was reserved with, longer ranges are just left behind
+template <typename T>
+void range_pool_release(Range_Pool<T>& pool, Range_Handle<T> handle) {
+    if (!handle.length || handle.length >= range_pool_max_released_length || handle.generation != pool.generation) {
+        return;
+    }
+
+    memcpy(&pool.values[handle.offset], &pool.first_released[handle.length], sizeof(u32));
+
+    pool.first_released[handle.length] = handle.offset + 1;
+}
+
+// Values are contiguous, so the pointer can be indexed up to handle.length, and stays valid until the pool is reset
+template <typename T>
+inline T* range_pool_get(Range_Pool<T>& pool, Range_Handle<T> handle) {
+    if (!handle.length) {
+        return NULL;
+    }
+
+    if (handle.generation != pool.generation) {
+        assert(!"Range handle from before the pool was reset");
+        return NULL;
+    }
+
+    return &pool.values[handle.offset];
+}
+
+// Every range handed out before becomes stale
+template <typename T>
+inline void range_pool_reset(Range_Pool<T>& pool) {
+    block_array_soft_reset(pool.values);
+    memset(pool.first_released, 0, sizeof(pool.first_released));
+    pool.generation++;
+
+    if (!pool.generation) {
+        pool.generation = 1;
+    }
+}
@@ -1,230 +1,322 @@
 #pragma once
 
 #include <cstdlib>
+#include <cstring>
 #include "common.h"
 
-static const struct {
-    u32 max_entries, size, rehash;
-} hash_sizes[] = {
-        {2,            5,            3},
-        {4,            7,            5},
-        {8,            13,           11},
-        {16,           19,           17},
-        {32,           43,           41},
-        {64,           73,           71},
-        {128,          151,          149},
-        {256,          283,          281},
-        {512,          571,          569},
-        {1024,         1153,         1151},
-        {2048,         2269,         2267},
-        {4096,         4519,         4517},
-        {8192,         9013,         9011},
-        {16384,        18043,        18041},
-        {32768,        36109,        36107},
-        {65536,        72091,        72089},
-        {131072,       144409,       144407},
-        {262144,       288361,       288359},
-        {524288,       576883,       576881},
-        {1048576,      1153459,      1153457},
-        {2097152,      2307163,      2307161},
-        {4194304,      4613893,      4613891},
-        {8388608,      9227641,      9227639},
-        {16777216,     18455029,     18455027},
-        {33554432,     36911011,     36911009},
-        {67108864,     73819861,     73819859},
-        {134217728,    147639589,    147639587},
-        {268435456,    295279081,    295279079},
-        {536870912,    590559793,    590559791},
-        {1073741824,   1181116273,   1181116271},
-        {2147483648ul, 2362232233ul, 2362232231ul}
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Open addressing in the style of SwissTable: power of two capacity, one control byte per slot
+ *  and lookups which check 16 control bytes at once.
+ *
+ * Control byte is either id_hash_map_empty or the top 7 bits of the hash, so most non-matching slots are
+ *  rejected without touching the slot itself. Probing is linear, a lookup stops at the first group of
+ *  16 control bytes which has an empty one in it.
+ *
+ * Control bytes are followed by a copy of the first group, so a group can be loaded at any index without wrapping.
+ *
+ * Hasher is picked per map, functions which take a hash expect it to come from the same Hasher,
+ *  that's so callers can store the hash next to the id and skip hashing on lookups.
+ */
+
+struct Id_Hasher {
+    static u32 hash(s32 id) {
+        return hash_id(id);
+    }
+
+    template <typename Kind>
+    static u32 hash(Id<Kind> id) {
+        return id.hash;
+    }
+};
+
+// Key is already a good hash, like avatar url hashes
+struct Prehashed_Hasher {
+    static u32 hash(u64 key) {
+        return (u32) key;
+    }
 };
 
-#define hash_table_foreach(ht, entry)                \
-    for (entry = id_hash_table_next_entry(ht, (Id_Hash_Entry<Key, T, NULL_VALUE>*) NULL);        \
-         entry != NULL;                    \
-         entry = id_hash_table_next_entry(ht, entry))
+static const u8 id_hash_map_empty = 0x80;
+static const u32 id_hash_map_group_width = 16;
+static const u32 id_hash_map_min_capacity = 16;
 
-template<typename Key, typename T, T NULL_VALUE = nullptr>
-struct Id_Hash_Entry {
+template<typename Key, typename T>
+struct Id_Hash_Slot {
     u32 hash;
-    T data;
     Key key;
-    bool present;
+    T data;
 };
 
-template<typename Key, typename T, T NULL_VALUE = nullptr>
+template<typename Key, typename T, T NULL_VALUE = nullptr, typename Hasher = Id_Hasher>
 struct Id_Hash_Map {
-    Id_Hash_Entry<Key, T, NULL_VALUE>* table = NULL;
-    u32 size; // TODO rename this
-    u32 rehash;
-    u32 max_entries;
-    u32 size_index;
-    u32 entries;
+    u8* control = NULL;
+    Id_Hash_Slot<Key, T>* table = NULL;
+    u32 capacity = 0;
+    u32 entries = 0;
 };
 
-template<typename Key, typename T, T NULL_VALUE = nullptr>
-void id_hash_map_init(Id_Hash_Map<Key, T, NULL_VALUE>* map) {
-    map->size_index = 0;
-    map->size = hash_sizes[map->size_index].size;
-    map->rehash = hash_sizes[map->size_index].rehash;
-    map->max_entries = hash_sizes[map->size_index].max_entries;
-    map->table = (Id_Hash_Entry<Key, T, NULL_VALUE>*) CALLOC(map->size, sizeof(Id_Hash_Entry<Key, T, NULL_VALUE>));
-    map->entries = 0;
+inline u8 id_hash_map_h2(u32 hash) {
+    return (u8) (hash >> 25);
 }
 
-template<typename Key, typename T, T NULL_VALUE = nullptr>
-void id_hash_map_destroy(Id_Hash_Map<Key, T, NULL_VALUE>* map) {
-    FREE(map->table);
+// Kept at most 7/8 full
+inline u32 id_hash_map_max_entries(u32 capacity) {
+    return capacity - capacity / 8;
 }
 
-template<typename Key, typename T, T NULL_VALUE = nullptr>
-void id_hash_map_clear(Id_Hash_Map<Key, T, NULL_VALUE>* map) {
-//    if (!map->size) {
-//        return;
-//    }
-//
-//    for (u32 index = 0; index < map->total_buckets; index++) {
-//        if (map->buckets[index].contents) {
-//            FREE(map->buckets[index].contents);
-//        }
-//    }
-//
-//    memset(map->buckets, 0, sizeof(Hash_Bucket < T > ) * map->total_buckets);
-//    map->size = 0;
-}
-
-template<typename Key, typename T, T NULL_VALUE = nullptr>
-Id_Hash_Entry<Key, T, NULL_VALUE>* id_hash_table_next_entry(Id_Hash_Map<Key, T, NULL_VALUE>* map, Id_Hash_Entry<Key, T, NULL_VALUE>* entry) {
-    if (entry == NULL) {
-        entry = map->table;
-    } else {
-        entry++;
-    }
-
-    for (; entry != map->table + map->size; entry++) {
-        if (entry->present) {
-            return entry;
-        }
+struct Id_Hash_Group_Masks {
+    u32 matching;
+    u32 empty;
+};
+
+inline Id_Hash_Group_Masks id_hash_map_match_group(u8* group, u8 h2) {
+    Id_Hash_Group_Masks masks;
+
+#if defined(__SSE2__)
+    __m128i control_bytes = _mm_loadu_si128((const __m128i*) group);
+
+    masks.matching = (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(control_bytes, _mm_set1_epi8((char) h2)));
+    masks.empty = (u32) _mm_movemask_epi8(control_bytes);
+#else
+    masks.matching = 0;
+    masks.empty = 0;
+
+    for (u32 index = 0; index < id_hash_map_group_width; index++) {
+        masks.matching |= (u32) (group[index] == h2) << index;
+        masks.empty |= (u32) (group[index] == id_hash_map_empty) << index;
     }
+#endif
 
-    return NULL;
+    return masks;
 }
 
-template<typename Key, typename T, T NULL_VALUE = nullptr>
-void id_hash_map_rehash(Id_Hash_Map<Key, T, NULL_VALUE>* map, u32 new_size_index) {
-    Id_Hash_Map<Key, T, NULL_VALUE> old_ht;
-    Id_Hash_Entry<Key, T, NULL_VALUE>* table;
+template<typename Key, typename T, T NULL_VALUE, typename Hasher>
+inline void id_hash_map_set_control(Id_Hash_Map<Key, T, NULL_VALUE, Hasher>* map, u32 index, u8 value) {
+    map->control[index] = value;
 
-    if (new_size_index >= ARRAY_SIZE(hash_sizes))
-        return;
+    if (index < id_hash_map_group_width) {
+        map->control[map->capacity + index] = value;
+    }
+}
 
-    table = (Id_Hash_Entry<Key, T, NULL_VALUE>*) CALLOC(hash_sizes[new_size_index].size, sizeof(Id_Hash_Entry<Key, T, NULL_VALUE>));
-    if (table == NULL)
+template<typename Key, typename T, T NULL_VALUE, typename Hasher>
+void id_hash_map_allocate(Id_Hash_Map<Key, T, NULL_VALUE, Hasher>* map, u32 capacity) {
+    map->capacity = capacity;
+    map->entries = 0;
+    map->control = (u8*) MALLOC(capacity + id_hash_map_group_width);
+    map->table = (Id_Hash_Slot<Key, T>*) MALLOC(sizeof(Id_Hash_Slot<Key, T>) * capacity);
+
+    memset(map->control, id_hash_map_empty, capacity + id_hash_map_group_width);
+}
+
+template<typename Key, typename T, T NULL_VALUE, typename Hasher>
+void id_hash_map_init(Id_Hash_Map<Key, T, NULL_VALUE, Hasher>* map) {
+    id_hash_map_allocate(map, id_hash_map_min_capacity);
+}
+
+template<typename Key, typename T, T NULL_VALUE, typename Hasher>
+void id_hash_map_destroy(Id_Hash_Map<Key, T, NULL_VALUE, Hasher>* map) {
+    FREE(map->control);
+    FREE(map->table);
+
+    *map = {};
+}
+
+// Keeps the allocation, so refilling the map with a similar amount of entries doesn't rehash
+template<typename Key, typename T, T NULL_VALUE, typename Hasher>
+void id_hash_map_clear(Id_Hash_Map<Key, T, NULL_VALUE, Hasher>* map) {
+    if (!map->capacity) {
         return;
+    }
 
-    old_ht = *map;
+    memset(map->control, id_hash_map_empty, map->capacity + id_hash_map_group_width);
 
-    map->table = table;
-    map->size_index = new_size_index;
-    map->size = hash_sizes[map->size_index].size;
-    map->rehash = hash_sizes[map->size_index].rehash;
-    map->max_entries = hash_sizes[map->size_index].max_entries;
     map->entries = 0;
+}
+
+// Slot for a key which is known not to be in the map, first empty one after its home slot
+template<typename Key, typename T, T NULL_VALUE, typename Hasher>
+u32 id_hash_map_find_empty_slot(Id_Hash_Map<Key, T, NULL_VALUE, Hasher>* map, u32 hash) {
+    u32 mask = map->capacity - 1;
+
+    for (u32 position = hash & mask;; position = (position + id_hash_map_group_width) & mask) {
+        u32 empty = id_hash_map_match_group(map->control + position, 0).empty;
+
+        if (empty) {
+            return (position + __builtin_ctz(empty)) & mask;
+        }
+    }
+}
+
+template<typename Key, typename T, T NULL_VALUE, typename Hasher>
+void id_hash_map_rehash(Id_Hash_Map<Key, T, NULL_VALUE, Hasher>* map, u32 new_capacity) {
+    Id_Hash_Map<Key, T, NULL_VALUE, Hasher> old_map = *map;
+
+    id_hash_map_allocate(map, new_capacity);
 
-    Id_Hash_Entry<Key, T, NULL_VALUE>* entry;
+    for (u32 index = 0; index < old_map.capacity; index++) {
+        if (old_map.control[index] != id_hash_map_empty) {
+            Id_Hash_Slot<Key, T>& slot = old_map.table[index];
+            u32 new_index = id_hash_map_find_empty_slot(map, slot.hash);
 
-    hash_table_foreach(&old_ht, entry) {
-        id_hash_map_put(map, entry->data, entry->key, entry->hash);
+            id_hash_map_set_control(map, new_index, id_hash_map_h2(slot.hash));
+            map->table[new_index] = slot;
+        }
     }
 
-    FREE(old_ht.table);
+    map->entries = old_map.entries;
+
+    if (old_map.control) {
+        FREE(old_map.control);
+        FREE(old_map.table);
+    }
 }
 
-template<typename Key, typename T, T NULL_VALUE = nullptr>
-bool id_hash_map_put(Id_Hash_Map<Key, T, NULL_VALUE>* map, T value, Key key, u32 hash) {
-    Id_Hash_Entry<Key, T, NULL_VALUE>* available_entry = NULL;
+// Grows the map up front so putting num_entries entries won't rehash on the way
+template<typename Key, typename T, T NULL_VALUE, typename Hasher>
+void id_hash_map_reserve(Id_Hash_Map<Key, T, NULL_VALUE, Hasher>* map, u32 num_entries) {
+    u32 new_capacity = map->capacity ? map->capacity : id_hash_map_min_capacity;
+
+    while (id_hash_map_max_entries(new_capacity) < num_entries) {
+        new_capacity *= 2;
+    }
 
-    if (map->entries >= map->max_entries) {
-        id_hash_map_rehash(map, map->size_index + 1);
+    if (new_capacity != map->capacity) {
+        id_hash_map_rehash(map, new_capacity);
     }
+}
 
-    u32 start_hash_address = hash % map->size;
-    u32 hash_address = start_hash_address;
+// Replaces the value if the key is already there
+template<typename Key, typename T, T NULL_VALUE, typename Hasher>
+bool id_hash_map_put(Id_Hash_Map<Key, T, NULL_VALUE, Hasher>* map, T value, Key key, u32 hash) {
+    if (map->entries + 1 > id_hash_map_max_entries(map->capacity)) {
+        id_hash_map_rehash(map, map->capacity ? map->capacity * 2 : id_hash_map_min_capacity);
+    }
 
-    do {
-        Id_Hash_Entry<Key, T, NULL_VALUE>* entry = map->table + hash_address;
-        u32 double_hash;
+    u32 mask = map->capacity - 1;
+    u8 h2 = id_hash_map_h2(hash);
 
-        if (!entry->present) {
-            /* Stash the first available entry we find */
-            if (available_entry == NULL)
-                available_entry = entry;
+    for (u32 position = hash & mask;; position = (position + id_hash_map_group_width) & mask) {
+        Id_Hash_Group_Masks masks = id_hash_map_match_group(map->control + position, h2);
 
-            break;
-        }
+        for (u32 matching = masks.matching; matching; matching &= matching - 1) {
+            Id_Hash_Slot<Key, T>& slot = map->table[(position + __builtin_ctz(matching)) & mask];
 
-        /* Implement replacement when another insert happens
-         * with a matching key.  This is a relatively common
-         * feature of hash tables, with the alternative
-         * generally being "insert the new value as well, and
-         * return it first when the key is searched for".
-         *
-         * Note that the hash table doesn't have a delete
-         * callback.  If freeing of old data pointers is
-         * required to avoid memory leaks, perform a search
-         * before inserting.
-         */
-        if (entry->hash == hash && key == entry->key) {
-            entry->key = key;
-            entry->present = true;
-            entry->data = value;
-            return true;
+            if (slot.hash == hash && slot.key == key) {
+                slot.data = value;
+                return true;
+            }
         }
 
-        double_hash = 1 + hash % map->rehash;
+        if (masks.empty) {
+            u32 index = (position + __builtin_ctz(masks.empty)) & mask;
 
-        hash_address = (hash_address + double_hash) % map->size;
-    } while (hash_address != start_hash_address);
+            Id_Hash_Slot<Key, T>& slot = map->table[index];
+            slot.hash = hash;
+            slot.key = key;
+            slot.data = value;
 
-    if (available_entry) {
-        available_entry->hash = hash;
-        available_entry->key = key;
-        available_entry->data = value;
-        available_entry->present = true;
-        map->entries++;
-        return true;
-    }
+            id_hash_map_set_control(map, index, h2);
 
-    /* We could hit here if a required resize failed. An unchecked-malloc
-     * application could ignore this result.
-     */
-    return false;
+            map->entries++;
+
+            return true;
+        }
+    }
 }
 
-template<typename Key, typename T, T NULL_VALUE = nullptr>
-T id_hash_map_get(Id_Hash_Map<Key, T, NULL_VALUE>* map, Key key, u32 hash) {
-    if (!map->size) {
+template<typename Key, typename T, T NULL_VALUE, typename Hasher>
+T id_hash_map_get(Id_Hash_Map<Key, T, NULL_VALUE, Hasher>* map, Key key, u32 hash) {
+    if (!map->capacity) {
         return NULL_VALUE;
     }
 
-    u32 start_hash_address = hash % map->size;
-    u32 hash_address = start_hash_address;
+    u32 mask = map->capacity - 1;
+    u8 h2 = id_hash_map_h2(hash);
+
+    for (u32 position = hash & mask;; position = (position + id_hash_map_group_width) & mask) {
+        Id_Hash_Group_Masks masks = id_hash_map_match_group(map->control + position, h2);
 
-    do {
-        u32 double_hash;
+        for (u32 matching = masks.matching; matching; matching &= matching - 1) {
+            Id_Hash_Slot<Key, T>& slot = map->table[(position + __builtin_ctz(matching)) & mask];
 
-        Id_Hash_Entry<Key, T, NULL_VALUE>* entry = map->table + hash_address;
+            if (slot.hash == hash && slot.key == key) {
+                return slot.data;
+            }
+        }
 
-        if (!entry->present) {
+        if (masks.empty) {
             return NULL_VALUE;
-        } else if (entry->hash == hash && key == entry->key) {
-            return entry->data;
         }
+    }
+}
+
+/**
+ * Entries always sit at the first empty slot after their home slot, same as in plain linear probing,
+ *  so instead of leaving a tombstone we shift the following entries back into the hole.
+ */
+template<typename Key, typename T, T NULL_VALUE, typename Hasher>
+bool id_hash_map_remove(Id_Hash_Map<Key, T, NULL_VALUE, Hasher>* map, Key key, u32 hash) {
+    if (!map->capacity) {
+        return false;
+    }
 
-        double_hash = 1 + hash % map->rehash;
+    u32 mask = map->capacity - 1;
+    u8 h2 = id_hash_map_h2(hash);
+    u32 hole = map->capacity;
 
-        hash_address = (hash_address + double_hash) % map->size;
-    } while (hash_address != start_hash_address);
+    for (u32 position = hash & mask; hole == map->capacity; position = (position + id_hash_map_group_width) & mask) {
+        Id_Hash_Group_Masks masks = id_hash_map_match_group(map->control + position, h2);
+
+        for (u32 matching = masks.matching; matching; matching &= matching - 1) {
+            u32 index = (position + __builtin_ctz(matching)) & mask;
+            Id_Hash_Slot<Key, T>& slot = map->table[index];
+
+            if (slot.hash == hash && slot.key == key) {
+                hole = index;
+                break;
+            }
+        }
+
+        if (hole == map->capacity && masks.empty) {
+            return false;
+        }
+    }
+
+    for (u32 index = (hole + 1) & mask; map->control[index] != id_hash_map_empty; index = (index + 1) & mask) {
+        u32 home = map->table[index].hash & mask;
+
+        // Only entries whose probe passed through the hole can move into it
+        if (((index - home) & mask) >= ((index - hole) & mask)) {
+            map->table[hole] = map->table[index];
+            id_hash_map_set_control(map, hole, map->control[index]);
+
+            hole = index;
+        }
+    }
+
+    id_hash_map_set_control(map, hole, id_hash_map_empty);
+
+    map->entries--;
+
+    return true;
+}
+
+template<typename Key, typename T, T NULL_VALUE, typename Hasher>
+bool id_hash_map_put(Id_Hash_Map<Key, T, NULL_VALUE, Hasher>* map, T value, Key key) {
+    return id_hash_map_put(map, value, key, Hasher::hash(key));
+}
+
+template<typename Key, typename T, T NULL_VALUE, typename Hasher>
+T id_hash_map_get(Id_Hash_Map<Key, T, NULL_VALUE, Hasher>* map, Key key) {
+    return id_hash_map_get(map, key, Hasher::hash(key));
+}
 
-    return NULL_VALUE;
+template<typename Key, typename T, T NULL_VALUE, typename Hasher>
+bool id_hash_map_remove(Id_Hash_Map<Key, T, NULL_VALUE, Hasher>* map, Key key) {
+    return id_hash_map_remove(map, key, Hasher::hash(key));
 }
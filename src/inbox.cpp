@@ -5,10 +5,12 @@
 #include "common.h"
 #include "json.h"
 #include "users.h"
+#include "tasks.h"
 #include "workflows.h"
 #include "ui.h"
 #include "renderer.h"
 #include "platform.h"
+#include "interned_strings.h"
 
 enum Inbox_Notification_Type {
     Inbox_Notification_Type_Assign,
@@ -31,7 +33,7 @@ struct Inbox_Notification {
     Inbox_Notification_Type type;
     User_Id author;
     Task_Id task;
-    String task_title;
+    Entity_Index task_summary;
     bool unread;
 
     union {
@@ -48,6 +50,8 @@ static void process_inbox_notification(Inbox_Notification* notification, char* j
 
     assert(object_token->type == JSMN_OBJECT);
 
+    String task_title{};
+
     for (u32 propety_index = 0; propety_index < object_token->size; propety_index++, token++) {
         jsmntok_t* property_token = token++;
 
@@ -64,7 +68,7 @@ static void process_inbox_notification(Inbox_Notification* notification, char* j
         } else if (json_string_equals(json, property_token, "taskId")) {
             json_token_to_right_part_of_id16(json, next_token, notification->task);
         } else if (json_string_equals(json, property_token, "taskTitle")) {
-            json_token_to_string(json, next_token, notification->task_title);
+            json_token_to_interned_string(json, next_token, task_title);
         } else if (json_string_equals(json, property_token, "type")) {
 
             if (json_string_equals(json, next_token, "Assign")) {
@@ -78,7 +82,7 @@ static void process_inbox_notification(Inbox_Notification* notification, char* j
         } else if (json_string_equals(json, property_token, "commentId")) {
             json_token_to_right_part_of_id16(json, next_token, notification->comment.id);
         } else if (json_string_equals(json, property_token, "commentText")) {
-            json_token_to_string(json, next_token, notification->comment.text);
+            json_token_to_interned_string(json, next_token, notification->comment.text);
 
         } else if (json_string_equals(json, property_token, "oldCustomStatusId")) {
             json_token_to_right_part_of_id16(json, next_token, notification->status.old_status);
@@ -90,6 +94,8 @@ static void process_inbox_notification(Inbox_Notification* notification, char* j
             token--;
         }
     }
+
+    notification->task_summary = update_task_title(notification->task, task_title);
 }
 
 u32 get_unread_notifications() {
@@ -184,7 +190,7 @@ static bool draw_inbox_entry(ImDrawList* draw_list, ImVec2 top_left, ImVec2 item
         return state.pressed;
     }
 
-    String task_title = notification->task_title;
+    String task_title = get_task_summary(notification->task_summary)->title;
 
     u32 background_color = 0;
 
@@ -301,4 +307,21 @@ void process_inbox_data(char* json, u32 data_size, jsmntok_t*& token) {
             unread_notifications++;
         }
     }
-}
\ No newline at end of file
+}
+
+void keep_inbox_interned_strings() {
+    for (u32 index = 0; index < notifications.length; index++) {
+        Inbox_Notification& notification = notifications[index];
+
+        // Status notifications have status ids where the comment would be
+        if (notification.type != Inbox_Notification_Type_Status) {
+            keep_interned_string(notification.comment.text);
+        }
+    }
+}
+
+void keep_inbox_tasks() {
+    for (u32 index = 0; index < notifications.length; index++) {
+        keep_task(notifications[index].task_summary);
+    }
+}
@@ -1,3 +1,5 @@
 void process_inbox_data(char* json, u32 data_size, jsmntok_t*& token);
 void draw_inbox();
-u32 get_unread_notifications();
\ No newline at end of file
+u32 get_unread_notifications();
+void keep_inbox_interned_strings();
+void keep_inbox_tasks();
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include <cstring>
+#include "interned_strings.h"
+
+struct Interned_String_Block {
+    Interned_String_Block* next;
+    u32 size;
+};
+
+// Slot is empty when start is NULL
+struct Interned_String_Slot {
+    char* start;
+    u32 length;
+    u32 hash;
+};
+
+static const u32 default_block_size = 1024 * 64;
+static const u32 initial_num_slots = 4096;
+
+static Interned_String_Block* current_block = NULL;
+static char* pointer_current = NULL;
+static char* pointer_end = NULL;
+
+// Kept at most half full, size is a power of two so we can mask instead of mod
+static Interned_String_Slot* slots = NULL;
+static u32 num_slots = 0;
+static u32 num_unique_strings = 0;
+
+static u32 num_blocks = 0;
+static u32 reserved_bytes = 0;
+static u32 unique_bytes = 0;
+static u32 total_interned_bytes = 0;
+static u32 total_interned_strings = 0;
+static u64 total_released_json_bytes = 0;
+
+// Strings which were kept by the last collection, whatever was interned on top of them could be garbage
+static const u32 min_bytes_before_collection = 1024 * 1024;
+static u32 unique_bytes_after_collection = 0;
+
+// Previous generation, alive until end_interned_strings_collection
+static Interned_String_Block* collected_block = NULL;
+static Interned_String_Slot* collected_slots = NULL;
+static u32 collected_unique_bytes = 0;
+static u32 collected_reserved_bytes = 0;
+
+static u32 num_collections = 0;
+static u64 total_collected_bytes = 0;
+static u64 total_released_block_bytes = 0;
+
+static char* copy_into_blocks(const char* start, u32 length) {
+    if (pointer_current + length > pointer_end) {
+        u32 size = MAX(default_block_size, length);
+
+        Interned_String_Block* block = (Interned_String_Block*) MALLOC(sizeof(Interned_String_Block) + size);
+        block->next = current_block;
+        block->size = size;
+
+        current_block = block;
+        pointer_current = (char*) (block + 1);
+        pointer_end = pointer_current + size;
+
+        num_blocks++;
+        reserved_bytes += size;
+    }
+
+    char* result = pointer_current;
+
+    memcpy(result, start, length);
+
+    pointer_current += length;
+
+    return result;
+}
+
+static void put_into_slots(Interned_String_Slot* target_slots, u32 target_num_slots, Interned_String_Slot& value) {
+    u32 mask = target_num_slots - 1;
+
+    for (u32 index = value.hash & mask;; index = (index + 1) & mask) {
+        if (!target_slots[index].start) {
+            target_slots[index] = value;
+            return;
+        }
+    }
+}
+
+static void grow_slots() {
+    u32 new_num_slots = num_slots ? num_slots * 2 : initial_num_slots;
+
+    Interned_String_Slot* new_slots = (Interned_String_Slot*) CALLOC(new_num_slots, sizeof(Interned_String_Slot));
+
+    for (u32 index = 0; index < num_slots; index++) {
+        if (slots[index].start) {
+            put_into_slots(new_slots, new_num_slots, slots[index]);
+        }
+    }
+
+    if (slots) {
+        FREE(slots);
+    }
+
+    slots = new_slots;
+    num_slots = new_num_slots;
+}
+
+static String find_or_copy(const char* start, u32 length) {
+    String result{};
+
+    if ((num_unique_strings + 1) * 2 > num_slots) {
+        grow_slots();
+    }
+
+    u32 hash = XXH32(start, length, hash_seed);
+    u32 mask = num_slots - 1;
+
+    for (u32 index = hash & mask;; index = (index + 1) & mask) {
+        Interned_String_Slot& slot = slots[index];
+
+        if (!slot.start) {
+            slot.start = copy_into_blocks(start, length);
+            slot.length = length;
+            slot.hash = hash;
+
+            num_unique_strings++;
+            unique_bytes += length;
+
+            result.start = slot.start;
+            result.length = length;
+
+            return result;
+        }
+
+        if (slot.hash == hash && slot.length == length && memcmp(slot.start, start, length) == 0) {
+            result.start = slot.start;
+            result.length = length;
+
+            return result;
+        }
+    }
+}
+
+String intern_string(const char* start, u32 length) {
+    if (!length) {
+        return String{};
+    }
+
+    total_interned_strings++;
+    total_interned_bytes += length;
+
+    return find_or_copy(start, length);
+}
+
+bool interned_strings_need_collection() {
+    return unique_bytes >= MAX(min_bytes_before_collection, unique_bytes_after_collection * 2);
+}
+
+void begin_interned_strings_collection() {
+    collected_block = current_block;
+    collected_slots = slots;
+    collected_unique_bytes = unique_bytes;
+    collected_reserved_bytes = reserved_bytes;
+
+    current_block = NULL;
+    pointer_current = NULL;
+    pointer_end = NULL;
+
+    // Same size as before, so keeping everything never has to grow them
+    slots = (Interned_String_Slot*) CALLOC(num_slots, sizeof(Interned_String_Slot));
+
+    num_unique_strings = 0;
+    num_blocks = 0;
+    reserved_bytes = 0;
+    unique_bytes = 0;
+}
+
+void keep_interned_string(String& string) {
+    if (string.length) {
+        string = find_or_copy(string.start, string.length);
+    }
+}
+
+void end_interned_strings_collection() {
+    while (collected_block) {
+        Interned_String_Block* next = collected_block->next;
+
+        FREE(collected_block);
+
+        collected_block = next;
+    }
+
+    if (collected_slots) {
+        FREE(collected_slots);
+        collected_slots = NULL;
+    }
+
+    num_collections++;
+    total_collected_bytes += collected_unique_bytes - unique_bytes;
+    total_released_block_bytes += collected_reserved_bytes - reserved_bytes;
+
+    unique_bytes_after_collection = unique_bytes;
+}
+
+void interned_strings_report_released_json(u32 json_length) {
+    total_released_json_bytes += json_length;
+}
+
+void draw_interned_strings_debug_info() {
+    ImGui::Text("Interned strings: %i unique taking %.2fkb (%i blocks, %.2fkb reserved) out of %i interned taking %.2fkb",
+                num_unique_strings, unique_bytes / 1024.0f, num_blocks, reserved_bytes / 1024.0f, total_interned_strings, total_interned_bytes / 1024.0f);
+    ImGui::Text("%.2fkb of JSON responses released after parsing instead of being kept alive", total_released_json_bytes / 1024.0f);
+    ImGui::Text("%i collections dropped %.2fkb of strings nobody used anymore, releasing %.2fkb of blocks",
+                num_collections, total_collected_bytes / 1024.0f, total_released_block_bytes / 1024.0f);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "common.h"
+
+/**
+ * Strings which outlive the JSON they were parsed from: titles, names, urls and so on.
+ *
+ * Each distinct string is stored once, interning the same contents again returns the same String.
+ * Storage is a chain of blocks which never moves, interned strings should never be modified.
+ *
+ * Edits and reloads leave strings behind which nobody uses anymore, so once enough was interned the
+ *  storage is collected: a new generation is started, every owner passes the strings it still holds
+ *  through keep_interned_string, which moves them over, and then the old generation is freed as a whole.
+ * Interned strings stay valid until the next collection. Collections run between frames on the main
+ *  thread, never while a job reads interned strings.
+ */
+
+String intern_string(const char* start, u32 length);
+
+bool interned_strings_need_collection();
+void begin_interned_strings_collection();
+void keep_interned_string(String& string); // Same contents still mean the same pointer afterwards
+void end_interned_strings_collection();
+
+// Called when a response body is freed after parsing, only for the debug stats
+void interned_strings_report_released_json(u32 json_length);
+
+void draw_interned_strings_debug_info();
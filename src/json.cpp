@@ -1,14 +1,192 @@
 #include "common.h"
 #include "json.h"
 #include "platform.h"
+#include "interned_strings.h"
+#include "tracing.h"
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
 #include <cassert>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+const char* json_find_backslash(const char* start, u32 length) {
+    const char* end = start + length;
+    const char* current = start;
+
+#if defined(__SSE2__)
+    const __m128i backslashes = _mm_set1_epi8('\\');
+
+    for (; current + 16 <= end; current += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) current);
+        u32 mask = (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, backslashes));
+
+        if (mask) {
+            return current + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    return (const char*) memchr(current, '\\', end - current);
+}
+
+static s32 hex_digit_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+
+    return -1;
+}
+
+// Returns -1 if there are no 4 hex digits
+static s32 parse_hex4(const char* start, const char* end) {
+    if (end - start < 4) {
+        return -1;
+    }
+
+    s32 result = 0;
+
+    for (u32 index = 0; index < 4; index++) {
+        s32 digit = hex_digit_value(start[index]);
+
+        if (digit < 0) {
+            return -1;
+        }
+
+        result = (result << 4) | digit;
+    }
+
+    return result;
+}
+
+static char* encode_utf8(u32 code_point, char* output) {
+    if (code_point < 0x80) {
+        *output++ = (char) code_point;
+    } else if (code_point < 0x800) {
+        *output++ = (char) (0xC0 | (code_point >> 6));
+        *output++ = (char) (0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+        *output++ = (char) (0xE0 | (code_point >> 12));
+        *output++ = (char) (0x80 | ((code_point >> 6) & 0x3F));
+        *output++ = (char) (0x80 | (code_point & 0x3F));
+    } else {
+        *output++ = (char) (0xF0 | (code_point >> 18));
+        *output++ = (char) (0x80 | ((code_point >> 12) & 0x3F));
+        *output++ = (char) (0x80 | ((code_point >> 6) & 0x3F));
+        *output++ = (char) (0x80 | (code_point & 0x3F));
+    }
+
+    return output;
+}
+
+u32 json_unescape(const char* source, u32 length, char* destination) {
+    const char* end = source + length;
+    char* output = destination;
+
+    while (source < end) {
+        const char* backslash = json_find_backslash(source, (u32) (end - source));
+
+        if (!backslash) {
+            backslash = end;
+        }
+
+        memmove(output, source, backslash - source);
+        output += backslash - source;
+        source = backslash;
+
+        if (source == end) {
+            break;
+        }
+
+        // Lone backslash at the very end, jsmn wouldn't give us that, but just keep it
+        if (source + 1 == end) {
+            *output++ = *source++;
+            break;
+        }
+
+        char escaped = source[1];
+        source += 2;
+
+        switch (escaped) {
+            case '"':  *output++ = '"';  break;
+            case '\\': *output++ = '\\'; break;
+            case '/':  *output++ = '/';  break;
+            case 'b':  *output++ = '\b'; break;
+            case 'f':  *output++ = '\f'; break;
+            case 'n':  *output++ = '\n'; break;
+            case 'r':  *output++ = '\r'; break;
+            case 't':  *output++ = '\t'; break;
+
+            case 'u': {
+                s32 code_unit = parse_hex4(source, end);
+
+                if (code_unit < 0) {
+                    *output++ = '\\';
+                    *output++ = 'u';
+                    break;
+                }
+
+                source += 4;
+
+                u32 code_point = (u32) code_unit;
+
+                // Surrogate pair, the low half has to follow as another \u escape
+                if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+                    s32 low = (end - source >= 6 && source[0] == '\\' && source[1] == 'u') ? parse_hex4(source + 2, end) : -1;
+
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + ((u32) low - 0xDC00);
+                        source += 6;
+                    } else {
+                        code_point = 0xFFFD;
+                    }
+                } else if (code_point >= 0xDC00 && code_point <= 0xDFFF) {
+                    code_point = 0xFFFD;
+                }
+
+                output = encode_utf8(code_point, output);
+
+                break;
+            }
+
+            default: {
+                *output++ = '\\';
+                *output++ = escaped;
+            }
+        }
+    }
+
+    return (u32) (output - destination);
+}
+
 void json_token_to_string(char* json, jsmntok_t* token, String &string) {
     string.start = json + token->start;
     string.length = token->end - token->start;
+
+    if (!json_find_backslash(string.start, string.length)) {
+        return;
+    }
+
+    char* decoded = (char*) talloc(string.length);
+
+    string.length = json_unescape(string.start, string.length, decoded);
+    string.start = decoded;
+}
+
+void json_token_to_interned_string(char* json, jsmntok_t* token, String &string) {
+    char* start = json + token->start;
+    u32 length = (u32) (token->end - token->start);
+
+    // Decoded only once, everything after that works with the interned UTF-8
+    if (json_find_backslash(start, length)) {
+        char* decoded = (char*) talloc(length);
+
+        string = intern_string(decoded, json_unescape(start, length, decoded));
+    } else {
+        string = intern_string(start, length);
+    }
 }
 
 void eat_json(jsmntok_t*& token) {
@@ -82,7 +260,10 @@ jsmntok_t* parse_json_into_tokens(char* content_json, u32 json_length, u32& resu
     u64 start_time = platform_get_app_time_precise();
 
     s32 num_tokens = 0;
+
+    Memory_Tag previous_tag = set_memory_tag(Memory_Tag_Json_Tokens);
     jsmntok_t* json_tokens = parse_json_iteratively(content_json, json_length, num_tokens);
+    set_memory_tag(previous_tag);
 
     assert(num_tokens > 0);
 
@@ -9,8 +9,16 @@
 
 typedef void (*Data_Process_Callback)(char* json, u32 data_size, jsmntok_t*& token);
 
+// Escape sequences are decoded into UTF-8. Strings without any point straight into the json, others are
+//  decoded into temporary storage, either way they are only valid until the response is freed
 void json_token_to_string(char* json, jsmntok_t* token, String &string);
+// Copied to interned storage, use this for everything which is kept after parsing
+void json_token_to_interned_string(char* json, jsmntok_t* token, String &string);
 void eat_json(jsmntok_t*& token);
+
+// Decoded string is never longer than the source one, so destination can be the source itself
+u32 json_unescape(const char* source, u32 length, char* destination);
+const char* json_find_backslash(const char* start, u32 length);
 jsmntok_t* parse_json_into_tokens(char* content_json, u32 json_length, u32& result_parsed_tokens);
 void process_json_data_segment(char* json, jsmntok_t* tokens, u32 num_tokens, Data_Process_Callback callback);
 
@@ -20,21 +28,23 @@ inline bool json_string_equals(char* json, jsmntok_t* tok, const char *s) {
     return (u32) strlen(s) == token_length && strncmp(json + tok->start, s, token_length) == 0;
 }
 
-inline void json_token_to_right_part_of_id16(char* json, jsmntok_t* token, s32& id) {
+template <typename Kind>
+inline void json_token_to_right_part_of_id16(char* json, jsmntok_t* token, Id<Kind>& id) {
     u8* token_start = (u8*) json + token->start;
     u8 result[UNBASE32_LEN(16)];
 
     // TODO wasteful to decode all bytes but only use some
     base32_decode(token_start, 16, result);
 
-    id = uchars_to_s32(result + 6);
+    id = make_id<Kind>(uchars_to_s32(result + 6));
 }
 
-inline void json_token_to_id8(char* json, jsmntok_t* token, s32& id) {
+template <typename Kind>
+inline void json_token_to_id8(char* json, jsmntok_t* token, Id<Kind>& id) {
     u8* token_start = (u8*) json + token->start;
     u8 result[UNBASE32_LEN(8)];
 
     base32_decode(token_start, 8, result);
 
-    id = uchars_to_s32((u8*) result + 1);
+    id = make_id<Kind>(uchars_to_s32((u8*) result + 1));
 }
\ No newline at end of file
@@ -1,41 +1,9 @@
 #include <cstdlib>
+#include <cassert>
 #include "common.h"
 
 #pragma once
 
-// TODO looks terribly slow to be honest. Though base might be cached when accessing in a loop
-// TODO maybe a lot of MALLOC/free for SubTaskIds/CustomFieldValues is not a bad idea?
-// TODO http://floooh.github.io/2018/06/17/handles-vs-pointers.html this is a way better idea
-template <typename T>
-struct Relative_Pointer {
-    T** base;
-    u32 offset;
-
-    T& operator *() {
-        return *(*base + offset);
-    }
-
-    T& operator [](const int index) {
-        return *(*base + offset + index);
-    }
-
-    T* operator ->() {
-        return *base + offset;
-    }
-};
-
-// TODO an interesting possibility would be to make something like this and allocate on demand
-/*
-struct Array_Block {
-    T elements[1024];
-};
-
-struct Block_Array {
-    Array_Block* blocks[1024];
-};
- */
-
-
 template <typename T, u16 initial_watermark>
 struct Lazy_Array {
     T* data = NULL;
@@ -84,18 +52,6 @@ u32 lazy_array_reserve_n_values_and_get_offset(Lazy_Array<T, initial_watermark>&
     return offset;
 };
 
-template <typename T, u16 initial_watermark>
-Relative_Pointer<T> lazy_array_reserve_n_values_relative_pointer(Lazy_Array<T, initial_watermark>& array, u32 n) {
-    Relative_Pointer<T> pointer;
-
-    pointer.base = &array.data;
-    pointer.offset = array.length;
-
-    lazy_array_reserve_n_values(array, n);
-
-    return pointer;
-};
-
 template <typename T, u16 initial_watermark>
 inline void lazy_array_soft_reset(Lazy_Array<T, initial_watermark>& lazy_array) {
     lazy_array.length = 0;
@@ -109,11 +65,112 @@ inline void lazy_array_clear(Lazy_Array<T, initial_watermark>& lazy_array) {
     lazy_array.data = NULL;
 }
 
-template <typename T>
-Relative_Pointer<T> relative_pointer(T*& base, u16 offset) {
-    Relative_Pointer<T> pointer;
-    pointer.base = &base;
-    pointer.offset = offset;
+/**
+ * Fixed size blocks allocated on demand, growing never moves existing values so pointers into the array stay
+ *  valid until it's reset. Only the table of block pointers gets reallocated.
+ *
+ * Values reserved together are always contiguous, a reservation that doesn't fit into the rest of the current
+ *  block skips to the next one. One bigger than block_size gets a single allocation spanning as many blocks
+ *  as it needs, the blocks it spans point into it, so indexing works the same.
+ */
+template <typename T, u32 block_size>
+struct Block_Array {
+    static_assert((block_size & (block_size - 1)) == 0, "Block size should be a power of two");
+
+    T** blocks = NULL;
+    u32* block_spans = NULL; // Blocks the allocation starting at a block covers, 0 if it points into an earlier one
+    u32 num_blocks = 0;
+    u32 blocks_watermark = 0;
+    u32 length = 0;
+
+    T& operator [](const u32 index) {
+        return blocks[index / block_size][index % block_size];
+    }
+};
+
+template <typename T, u32 block_size>
+T* block_array_reserve_n_values(Block_Array<T, block_size>& array, u32 n) {
+    u32 block_index = array.length / block_size;
+    u32 index_in_block = array.length % block_size;
+
+    if (index_in_block && index_in_block + n > block_size) {
+        block_index++;
+        index_in_block = 0;
+    }
+
+    u32 span = MAX((n + block_size - 1) / block_size, 1);
+
+    // Blocks from before a soft reset are reused, any block works for a span of one
+    bool can_reuse = block_index < array.num_blocks && (span == 1 || array.block_spans[block_index] >= span);
+
+    if (!can_reuse) {
+        u32 new_num_blocks = block_index + span;
+
+        // Everything from block_index on is past the length, so those allocations are unused
+        for (u32 index = block_index; index < array.num_blocks; index++) {
+            if (array.block_spans[index]) {
+                FREE(array.blocks[index]);
+            }
+        }
+
+        // An allocation from before block_index which reaches into the replaced blocks keeps only the blocks before them
+        if (block_index < array.num_blocks && !array.block_spans[block_index]) {
+            u32 owner = block_index - 1;
+
+            while (!array.block_spans[owner]) {
+                owner--;
+            }
+
+            array.block_spans[owner] = block_index - owner;
+        }
+
+        if (new_num_blocks > array.blocks_watermark) {
+            array.blocks_watermark = MAX(array.blocks_watermark * 2, MAX(new_num_blocks, 8));
+            array.blocks = (T**) REALLOC(array.blocks, sizeof(T*) * array.blocks_watermark);
+            array.block_spans = (u32*) REALLOC(array.block_spans, sizeof(u32) * array.blocks_watermark);
+        }
+
+        T* values = (T*) MALLOC(sizeof(T) * block_size * span);
+
+        for (u32 index = 0; index < span; index++) {
+            array.blocks[block_index + index] = values + index * block_size;
+            array.block_spans[block_index + index] = index ? 0 : span;
+        }
+
+        array.num_blocks = new_num_blocks;
+    }
+
+    array.length = block_index * block_size + index_in_block + n;
+
+    return array.blocks[block_index] + index_in_block;
+}
+
+template <typename T, u32 block_size>
+u32 block_array_reserve_n_values_and_get_offset(Block_Array<T, block_size>& array, u32 n) {
+    block_array_reserve_n_values(array, n);
+
+    return array.length - n;
+}
+
+template <typename T, u32 block_size>
+inline void block_array_soft_reset(Block_Array<T, block_size>& array) {
+    array.length = 0;
+}
+
+template <typename T, u32 block_size>
+void block_array_clear(Block_Array<T, block_size>& array) {
+    for (u32 block_index = 0; block_index < array.num_blocks; block_index++) {
+        if (array.block_spans[block_index]) {
+            FREE(array.blocks[block_index]);
+        }
+    }
+
+    FREE(array.blocks);
+    FREE(array.block_spans);
 
-    return pointer;
+    array.blocks = NULL;
+    array.block_spans = NULL;
+    array.num_blocks = 0;
+    array.blocks_watermark = 0;
+    array.length = 0;
 }
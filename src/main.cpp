@@ -26,6 +26,9 @@
 #include "header.h"
 #include "ui.h"
 #include "inbox.h"
+#include "avatar_cache.h"
+#include "interned_strings.h"
+#include "tasks.h"
 
 const Request_Id NO_REQUEST = -1;
 const Request_Id FOLDER_TREE_CHILDREN_REQUEST = -2; // TODO BIG HAQ
@@ -44,9 +47,10 @@ Request_Id modify_task_request = NO_REQUEST;
 Request_Id suggested_folders_request = NO_REQUEST;
 Request_Id suggested_contacts_request = NO_REQUEST;
 Request_Id starred_folders_request = NO_REQUEST;
+Request_Id avatar_cache_request = NO_REQUEST;
 
-const Account_Id NO_ACCOUNT = -1;
-const Folder_Id ROOT_FOLDER = -1;
+const Account_Id NO_ACCOUNT = make_id<Account>(-1);
+const Folder_Id ROOT_FOLDER = make_id<Folder>(-1);
 
 bool custom_statuses_were_loaded = false;
 
@@ -63,20 +67,10 @@ static Memory_Image logo{};
 
 View current_view = View_Task_List;
 
-Task_Id selected_folder_task_id = 0;
+Task_Id selected_folder_task_id{};
 
 Task current_task{};
 
-static char* task_json_content = NULL;
-static char* users_json_content = NULL;
-static char* accounts_json_content = NULL;
-static char* folder_tasks_json_content = NULL;
-static char* workflows_json_content = NULL;
-static char* folder_header_json_content = NULL;
-static char* suggested_folders_json_content = NULL; // TODO looks like a lot of waste
-static char* suggested_users_json_content = NULL; // TODO also there
-static char* starred_folders_json_content = NULL;
-static char* inbox_json_content = NULL;
 
 u32 tick = 0;
 
@@ -103,6 +97,9 @@ static Request_Id request_id_counter = 0;
 static double frame_times[60];
 static u32 last_frame_vtx_count = 0;
 
+// When nothing changes a frame shouldn't touch the heap, tests/frame_allocations_test.cpp guards the usual suspects
+static u32 last_frame_heap_allocations = 0;
+
 PRINTLIKE(3, 4) void api_request(Http_Method method, Request_Id& request_id, const char* format, ...) {
     // TODO use temporary storage there
     static char temporary_request_buffer[512];
@@ -119,7 +116,71 @@ PRINTLIKE(3, 4) void api_request(Http_Method method, Request_Id& request_id, con
     platform_api_request(request_id, temporary_request_buffer, method);
 }
 
-PRINTLIKE(2, 3) void image_request(Request_Id& request_id, const char* format, ...) {
+struct Image_Request_Route {
+    Request_Id request_id;
+    Image_Consumer consumer;
+};
+
+/**
+ * Direct mapped by request id. Ids are handed out sequentially, so two requests only land in the same slot
+ *  when more than table size requests are apart, which means a lot of them are in flight at once.
+ *  We just double the table in that case, entries which didn't collide before won't collide after.
+ */
+static Image_Request_Route* image_request_routes = NULL;
+static u32 image_request_routes_size = 0;
+
+static void grow_image_request_routes() {
+    u32 old_size = image_request_routes_size;
+    Image_Request_Route* old_routes = image_request_routes;
+
+    image_request_routes_size = old_size ? old_size * 2 : 64;
+    image_request_routes = (Image_Request_Route*) CALLOC(image_request_routes_size, sizeof(Image_Request_Route));
+
+    for (Image_Request_Route* it = old_routes; it != old_routes + old_size; it++) {
+        if (it->consumer.type != Image_Consumer_None) {
+            image_request_routes[it->request_id & (image_request_routes_size - 1)] = *it;
+        }
+    }
+
+    if (old_routes) {
+        FREE(old_routes);
+    }
+}
+
+static void put_image_request_route(Request_Id request_id, Image_Consumer consumer) {
+    while (true) {
+        if (image_request_routes_size) {
+            Image_Request_Route* route = &image_request_routes[request_id & (image_request_routes_size - 1)];
+
+            if (route->consumer.type == Image_Consumer_None) {
+                route->request_id = request_id;
+                route->consumer = consumer;
+
+                return;
+            }
+        }
+
+        grow_image_request_routes();
+    }
+}
+
+static Image_Consumer take_image_request_route(Request_Id request_id) {
+    Image_Consumer result{};
+
+    if (image_request_routes_size) {
+        Image_Request_Route* route = &image_request_routes[request_id & (image_request_routes_size - 1)];
+
+        if (route->request_id == request_id) {
+            result = route->consumer;
+
+            route->consumer.type = Image_Consumer_None;
+        }
+    }
+
+    return result;
+}
+
+PRINTLIKE(3, 4) void image_request(Request_Id& request_id, Image_Consumer consumer, const char* format, ...) {
     // TODO use temporary storage there
     static char temporary_request_buffer[512];
 
@@ -132,6 +193,8 @@ PRINTLIKE(2, 3) void image_request(Request_Id& request_id, const char* format, .
 
     request_id = request_id_counter++;
 
+    put_image_request_route(request_id, consumer);
+
     platform_load_remote_image(request_id, temporary_request_buffer);
 }
 
@@ -141,14 +204,20 @@ struct Json_With_Tokens {
     u32 num_tokens;
 };
 
-static void process_json_content(char*& json_reference, Data_Process_Callback callback, Json_With_Tokens json_with_tokens) {
-    if (json_reference) {
-        FREE(json_reference);
-    }
+static void process_json_content(Data_Process_Callback callback, Json_With_Tokens json_with_tokens) {
+    process_json_data_segment(json_with_tokens.json, json_with_tokens.tokens, json_with_tokens.num_tokens, callback);
+}
 
-    json_reference = json_with_tokens.json;
+// Views which hold task indices are the task list and the inbox, the task view only reads current_task
+static void sweep_unused_tasks() {
+    begin_task_sweep();
 
-    process_json_data_segment(json_with_tokens.json, json_with_tokens.tokens, json_with_tokens.num_tokens, callback);
+    keep_task_list_tasks();
+    keep_inbox_tasks();
+
+    u32 num_removed = end_task_sweep();
+
+    printf("Dropped %i tasks no view refers to\n", num_removed);
 }
 
 static void select_account() {
@@ -156,7 +225,7 @@ static void select_account() {
 
     selected_account_id = accounts[0].id;
 
-    platform_local_storage_set("selected_account", tprintf("%i", accounts[0].id));
+    platform_local_storage_set("selected_account", tprintf("%i", accounts[0].id.value));
 }
 
 void request_folder_children_for_folder_tree(Folder_Id folder_id) {
@@ -166,7 +235,7 @@ void request_folder_children_for_folder_tree(Folder_Id folder_id) {
 
     String url = tprintf("folders/%.16s/folders?descendants=false&fields=['color']", output_folder_and_account_id);
 
-    platform_api_request(FOLDER_TREE_CHILDREN_REQUEST, url.start, Http_Get, (void*) (intptr_t) folder_id);
+    platform_api_request(FOLDER_TREE_CHILDREN_REQUEST, url.start, Http_Get, (void*) (intptr_t) folder_id.value);
 }
 
 void request_multiple_folders(Array<Folder_Id> folders) {
@@ -219,10 +288,10 @@ static void request_last_selected_folder_if_present() {
     bool has_requested_a_folder = false;
 
     if (last_selected_folder) {
-        Folder_Id folder_id;
+        s32 folder_id;
 
         if (string_to_int(&folder_id, last_selected_folder, 10) == STR2INT_SUCCESS) {
-            select_and_request_folder_by_id(folder_id);
+            select_and_request_folder_by_id(make_id<Folder>(folder_id));
 
             has_requested_a_folder = true;
         }
@@ -242,6 +311,25 @@ static void request_data_for_selected_account() {
     request_suggestions_for_account(selected_account_id);
 }
 
+static Memory_Tag memory_tag_for_request(Request_Id request_id) {
+    if (request_id == FOLDER_TREE_CHILDREN_REQUEST || request_id == starred_folders_request ||
+        request_id == folders_request || request_id == suggested_folders_request) {
+        return Memory_Tag_Folder_Tree;
+    }
+
+    if (request_id == contacts_request || request_id == suggested_contacts_request) {
+        return Memory_Tag_Users;
+    }
+
+    if (request_id == folder_contents_request || request_id == folder_header_request ||
+        request_id == task_request || request_id == task_comments_request || request_id == modify_task_request ||
+        request_id == accounts_request || request_id == workflows_request) {
+        return Memory_Tag_Task_Model;
+    }
+
+    return Memory_Tag_Other;
+}
+
 extern "C"
 EXPORT
 void api_request_success(Request_Id request_id, char* content, u32 content_length, void* data) {
@@ -250,50 +338,50 @@ void api_request_success(Request_Id request_id, char* content, u32 content_lengt
     json_with_tokens.json = content;
     json_with_tokens.tokens = parse_json_into_tokens(content, content_length, json_with_tokens.num_tokens);
 
+    // Has to be picked before the request ids are reset below
+    Memory_Tag previous_tag = set_memory_tag(memory_tag_for_request(request_id));
+
     if (request_id == FOLDER_TREE_CHILDREN_REQUEST) {
-        // TODO @Leak content is leaked
-        process_folder_tree_children_request((Folder_Id) (intptr_t) data, content, json_with_tokens.tokens, json_with_tokens.num_tokens);
+        process_folder_tree_children_request(make_id<Folder>((s32) (intptr_t) data), content, json_with_tokens.tokens, json_with_tokens.num_tokens);
     } else if (request_id == NOTIFICATION_MARK_AS_READ_REQUEST) {
-        // TODO @Leak content is leaked
         process_json_data_segment(content, json_with_tokens.tokens, json_with_tokens.num_tokens, process_inbox_data);
     } else if (request_id == starred_folders_request) {
         starred_folders_request = NO_REQUEST;
 
-        process_json_content(starred_folders_json_content, process_starred_folders_data, json_with_tokens);
+        process_json_content(process_starred_folders_data, json_with_tokens);
     } else if (request_id == folders_request) {
         folders_request = NO_REQUEST;
 
-        // TODO @Leak content is leaked
         process_json_data_segment(content, json_with_tokens.tokens, json_with_tokens.num_tokens, process_multiple_folders_data);
     } else if (request_id == folder_contents_request) {
         folder_contents_request = NO_REQUEST;
 
-        process_json_content(folder_tasks_json_content, process_folder_contents_data, json_with_tokens);
+        process_json_content(process_folder_contents_data, json_with_tokens);
         finished_loading_folder_contents_at = tick;
+
+        sweep_unused_tasks();
     } else if (request_id == folder_header_request) {
         folder_header_request = NO_REQUEST;
 
-        process_json_content(folder_header_json_content, process_folder_header_data, json_with_tokens);
+        process_json_content(process_folder_header_data, json_with_tokens);
         finished_loading_folder_header_at = tick;
     } else if (request_id == task_request) {
         task_request = NO_REQUEST;
 
-        process_json_content(task_json_content, process_task_data, json_with_tokens);
+        process_json_content(process_task_data, json_with_tokens);
         finished_loading_task_at = tick;
     } else if (request_id == task_comments_request) {
         task_comments_request = NO_REQUEST;
 
         process_json_data_segment(json_with_tokens.json, json_with_tokens.tokens, json_with_tokens.num_tokens, process_task_comments_data);
         finished_loading_task_comments_at = tick;
-
-        FREE(json_with_tokens.json);
     } else if (request_id == contacts_request) {
         contacts_request = NO_REQUEST;
-        process_json_content(users_json_content, process_users_data, json_with_tokens);
+        process_json_content(process_users_data, json_with_tokens);
         finished_loading_users_at = tick;
     } else if (request_id == accounts_request) {
         accounts_request = NO_REQUEST;
-        process_json_content(accounts_json_content, process_accounts_data, json_with_tokens);
+        process_json_content(process_accounts_data, json_with_tokens);
 
         if (selected_account_id == NO_ACCOUNT) {
             select_account();
@@ -301,43 +389,84 @@ void api_request_success(Request_Id request_id, char* content, u32 content_lengt
         }
     } else if (request_id == workflows_request) {
         workflows_request = NO_REQUEST;
-        process_json_content(workflows_json_content, process_workflows_data, json_with_tokens);
+        process_json_content(process_workflows_data, json_with_tokens);
 
         custom_statuses_were_loaded = true;
         finished_loading_statuses_at = tick;
     } else if (request_id == suggested_folders_request) {
         suggested_folders_request = NO_REQUEST;
-        process_json_content(suggested_folders_json_content, process_suggested_folders_data, json_with_tokens);
+        process_json_content(process_suggested_folders_data, json_with_tokens);
     } else if (request_id == suggested_contacts_request) {
         suggested_contacts_request = NO_REQUEST;
-        process_json_content(suggested_users_json_content, process_suggested_users_data, json_with_tokens);
+        process_json_content(process_suggested_users_data, json_with_tokens);
     } else if (request_id == inbox_request) {
         inbox_request = NO_REQUEST;
-        process_json_content(inbox_json_content, process_inbox_data, json_with_tokens);
+        process_json_content(process_inbox_data, json_with_tokens);
     } else if (request_id == modify_task_request) {
         modify_task_request = NO_REQUEST;
 
-        process_json_content(task_json_content, process_task_data, json_with_tokens);
+        process_json_content(process_task_data, json_with_tokens);
     }
 
+    set_memory_tag(previous_tag);
+
+    // Nothing points into the response after parsing, strings which are kept around are interned
+    FREE(json_with_tokens.json);
     FREE(json_with_tokens.tokens);
+
+    interned_strings_report_released_json(content_length);
 }
 
 extern "C"
 EXPORT
 void image_load_success(Request_Id request_id, u8* pixel_data, u32 width, u32 height) {
-    User* user_or_null = find_user_by_avatar_request_id(request_id);
+    Image_Consumer consumer = take_image_request_route(request_id);
 
-    if (user_or_null) {
-        Memory_Image& avatar = user_or_null->avatar;
-        avatar.width = width;
-        avatar.height = height;
+    switch (consumer.type) {
+        case Image_Consumer_User_Avatar: {
+            // Texture is created from the downscaled cached copy once the avatar is drawn
+            avatar_cache_put(consumer.avatar_url_hash, pixel_data, width, height);
 
-        load_image_into_gpu_memory(avatar, pixel_data);
+            break;
+        }
+
+        case Image_Consumer_Memory_Image: {
+            consumer.image->width = width;
+            consumer.image->height = height;
+
+            load_image_into_gpu_memory(*consumer.image, pixel_data);
+
+            break;
+        }
+
+        case Image_Consumer_None: {
+            printf("Got image #%i nobody is waiting for\n", request_id);
+
+            break;
+        }
+    }
 
-        user_or_null->avatar_loaded_at = tick;
+    free(pixel_data);
+}
+
+// Only the route is dropped, consumers keep their request id so a broken url isn't requested again
+extern "C"
+EXPORT
+void image_load_failure(Request_Id request_id) {
+    Image_Consumer consumer = take_image_request_route(request_id);
+
+    if (consumer.type == Image_Consumer_None) {
+        printf("Image #%i nobody is waiting for failed to load\n", request_id);
+    }
+}
 
-        free(pixel_data);
+extern "C"
+EXPORT
+void file_load_finished(Request_Id request_id, char* content_or_null, u32 content_length) {
+    if (request_id == avatar_cache_request) {
+        avatar_cache_process_file(content_or_null, content_length);
+    } else if (content_or_null) {
+        FREE(content_or_null);
     }
 }
 
@@ -349,12 +478,12 @@ void select_and_request_folder_by_id(Folder_Id id) {
     set_current_folder_id(id);
     current_view = View_Task_List;
 
-    platform_local_storage_set("last_selected_folder", tprintf("%i", id));
+    platform_local_storage_set("last_selected_folder", tprintf("%i", id.value));
 
     api_request(Http_Get, folder_contents_request, "folders/%.*s/tasks%s", id_length, output_account_and_folder_id,
                 "?fields=['customFields','superTaskIds','parentIds','responsibleIds']&subTasks=true");
 
-    if (id >= 0) {
+    if (id.value >= 0) {
         api_request(Http_Get, folder_header_request, "folders/%.*s%s", id_length, output_account_and_folder_id, "?fields=['customColumnIds']");
     } else {
         folder_header_request = NO_REQUEST;
@@ -379,7 +508,8 @@ void request_task_by_task_id(Task_Id task_id) {
     task_view_open_requested = true;
 }
 
-void modify_task_e16(Task_Id task_id, const u8 entity_prefix, s32 entity_id, const char* command, bool array = true) {
+template <typename Kind>
+void modify_task_e16(Task_Id task_id, const u8 entity_prefix, Id<Kind> entity_id, const char* command, bool array = true) {
     u8 output_account_and_task_id[16];
     u8 output_entity_id[16];
 
@@ -395,7 +525,8 @@ void modify_task_e16(Task_Id task_id, const u8 entity_prefix, s32 entity_id, con
     );
 }
 
-void modify_task_e8(Task_Id task_id, const u8 entity_prefix, s32 entity_id, const char* command, bool array = true) {
+template <typename Kind>
+void modify_task_e8(Task_Id task_id, const u8 entity_prefix, Id<Kind> entity_id, const char* command, bool array = true) {
     u8 output_account_and_task_id[16];
     u8 output_entity_id[8];
 
@@ -465,9 +596,10 @@ static void draw_average_frame_time() {
     char* text_start;
     char* text_end;
 
-    tprintf("Loop time: %.2fms, %i vtx", &text_start, &text_end, sum / (float) ARRAY_SIZE(frame_times), last_frame_vtx_count);
+    tprintf("Loop time: %.2fms, %i vtx, %i allocs", &text_start, &text_end, sum / (float) ARRAY_SIZE(frame_times),
+            last_frame_vtx_count, last_frame_heap_allocations);
 
-    ImVec2 top_left = ImGui::GetIO().DisplaySize - ImVec2(200.0f, 20.0f) * platform_get_pixel_ratio();
+    ImVec2 top_left = ImGui::GetIO().DisplaySize - ImVec2(260.0f, 20.0f) * platform_get_pixel_ratio();
 
     ImGui::GetOverlayDrawList()->AddText(top_left, IM_COL32_BLACK, text_start, text_end);
 }
@@ -478,6 +610,11 @@ static void draw_memory_debug_contents() {
     ImGui::Text("%f %f", io.DisplaySize.x, io.DisplaySize.y);
     ImGui::Text("%f %f", io.DisplayFramebufferScale.x, io.DisplayFramebufferScale.y);
 
+    draw_avatar_cache_debug_info();
+    draw_temporary_storage_debug_info();
+    draw_task_list_debug_info();
+    draw_interned_strings_debug_info();
+
     if (ImGui::ListBoxHeader("Memory allocations", ImVec2(-1, -1))) {
         draw_memory_records();
 
@@ -514,7 +651,7 @@ static void draw_task_view_popup_if_necessary() {
 
         bool task_is_loading = task_request != NO_REQUEST || contacts_request != NO_REQUEST;
 
-        if (selected_folder_task_id && !task_is_loading) {
+        if (selected_folder_task_id.value && !task_is_loading) {
             draw_task_contents();
         } else {
             ImGui::ListBoxHeader("##task_content", ImVec2(-1, -1));
@@ -618,7 +755,7 @@ void handle_clipboard_paste(char* data, u32 data_length) {
         char* id_start = substring_start + strlen(search_for);
         u32 id_length = data_length - (id_start - data);
 
-        Task_Id id_value = 0;
+        s32 id_value = 0;
 
         for (char* c = id_start; c != id_start + id_length && *c; c++) {
             id_value = id_value * 10 + (*c - '0');
@@ -626,8 +763,38 @@ void handle_clipboard_paste(char* data, u32 data_length) {
 
         printf("Task Id %.*s found in buffer, loading\n", id_length, id_start);
 
-        request_task_by_task_id(id_value);
+        request_task_by_task_id(make_id<Task>(id_value));
+    }
+}
+
+// Every owner of interned strings keeps what it still holds, see interned_strings.h
+static void collect_interned_strings_if_necessary() {
+    if (!interned_strings_need_collection() || is_task_list_sort_running()) {
+        return;
+    }
+
+    u64 start_time = platform_get_app_time_precise();
+
+    begin_interned_strings_collection();
+
+    keep_account_interned_strings();
+    keep_workflow_interned_strings();
+    keep_folder_tree_interned_strings();
+    keep_user_interned_strings();
+    keep_task_interned_strings();
+    keep_task_list_interned_strings();
+    keep_inbox_interned_strings();
+
+    keep_interned_string(current_task.title);
+    keep_interned_string(current_task.permalink);
+
+    for (u32 index = 0; index < current_task.custom_field_values.length; index++) {
+        keep_interned_string(current_task.custom_field_values[index].value);
     }
+
+    end_interned_strings_collection();
+
+    printf("Collected interned strings in %.3fms\n", platform_get_delta_time_ms(start_time));
 }
 
 extern "C"
@@ -635,6 +802,11 @@ EXPORT
 void loop() {
     u64 frame_start_time = platform_get_app_time_precise();
 
+    collect_interned_strings_if_necessary();
+
+    // Responses are processed between frames, those allocations are expected
+    take_heap_allocation_count();
+
     clear_temporary_storage();
 
     tick++;
@@ -665,13 +837,22 @@ void loop() {
     frame_times[tick % (ARRAY_SIZE(frame_times))] = platform_get_delta_time_ms(frame_start_time); // Before assumed swapBuffers
 
     platform_end_frame();
+
+    last_frame_heap_allocations = take_heap_allocation_count();
+
+    write_memory_metrics_if_necessary();
+    update_avatar_cache();
 }
 
 void load_persisted_settings() {
     char* selected_account = platform_local_storage_get("selected_account");
 
     if (selected_account) {
-        if (string_to_int(&selected_account_id, selected_account, 10) == STR2INT_SUCCESS) {
+        s32 account_id;
+
+        if (string_to_int(&account_id, selected_account, 10) == STR2INT_SUCCESS) {
+            selected_account_id = make_id<Account>(account_id);
+
             if (selected_account_id != NO_ACCOUNT) {
                 request_data_for_selected_account();
             }
@@ -694,16 +875,6 @@ static void setup_ui() {
     ImGui::GetIO().ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
 }
 
-static void* imgui_malloc_wrapper(size_t size, void* user_data) {
-    (void) user_data;
-    return malloc(size);
-}
-
-static void imgui_free_wrapper(void* ptr, void* user_data) {
-    (void) user_data;
-    free(ptr);
-}
-
 EXPORT
 bool init() {
     init_temporary_storage();
@@ -714,10 +885,14 @@ bool init() {
 
     load_persisted_settings();
 
-    create_imgui_context();
+    avatar_cache_request = request_id_counter++;
+    platform_load_file(avatar_cache_request, avatar_cache_file_path);
 
+    // Before the context is created, so the context itself is tracked too
     ImGui::SetAllocatorFunctions(imgui_malloc_wrapper, imgui_free_wrapper);
 
+    create_imgui_context();
+
     bool result = platform_init();
 
     setup_ui();
@@ -739,4 +914,6 @@ int main() {
     }
 
     platform_loop();
+
+    return 0;
 }
\ No newline at end of file
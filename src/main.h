@@ -14,14 +14,36 @@ void api_request_success(Request_Id request_id, char* content, u32 content_lengt
 extern "C"
 void image_load_success(Request_Id request_id, u8* pixel_data, u32 width, u32 height);
 
+extern "C"
+void image_load_failure(Request_Id request_id);
+
+extern "C"
+void file_load_finished(Request_Id request_id, char* content_or_null, u32 content_length);
+
 enum View {
     View_Task_List,
     View_Inbox
 };
 
+// Decoded from what the value looks like, the field type then tells which of those to use
+enum Custom_Field_Value_Kind {
+    Custom_Field_Value_Kind_None,
+    Custom_Field_Value_Kind_Text,
+    Custom_Field_Value_Kind_Number,
+    Custom_Field_Value_Kind_Date,
+    Custom_Field_Value_Kind_Boolean
+};
+
 struct Custom_Field_Value {
     Custom_Field_Id field_id;
-    String value;
+    String value; // As it came, this is what's drawn
+    Custom_Field_Value_Kind kind;
+
+    union {
+        double number; // Numeric, currency, percentage and duration in minutes
+        s32 date; // Days since 1970-01-01
+        bool checked;
+    };
 };
 
 struct Task_Comment {
@@ -98,7 +120,23 @@ void mark_notification_as_read(Inbox_Notification_Id notification_id);
 extern "C" char* handle_clipboard_copy();
 extern "C" void handle_clipboard_paste(char* data, u32 data_length);
 
-PRINTLIKE(2, 3) void image_request(Request_Id& request_id, const char* format, ...);
+enum Image_Consumer_Type {
+    Image_Consumer_None,
+    Image_Consumer_User_Avatar,
+    Image_Consumer_Memory_Image
+};
+
+// Who receives the pixels once an image request completes
+struct Image_Consumer {
+    Image_Consumer_Type type;
+
+    union {
+        u64 avatar_url_hash;
+        Memory_Image* image; // Must outlive the request
+    };
+};
+
+PRINTLIKE(3, 4) void image_request(Request_Id& request_id, Image_Consumer consumer, const char* format, ...);
 
 // TODO move this into imgui extension file?
 namespace ImGui {
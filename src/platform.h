@@ -24,5 +24,18 @@ void platform_open_url(String& permalink);
 
 void platform_api_request(Request_Id request_id, char* url, Http_Method method, void* data = NULL);
 void platform_load_remote_image(Request_Id request_id, char* full_url);
+void platform_load_file(Request_Id request_id, const char* path); // Calls file_load_finished when done, content is yours
+void platform_write_file(const char* path, void* data, u32 data_length, bool append);
+bool platform_read_file_range(const char* path, u32 offset, void* data, u32 data_length); // Blocks, call from jobs
 void platform_local_storage_set(const char* key, String value); // TODO bad definition...
-char* platform_local_storage_get(const char* key); // You own the memory!
\ No newline at end of file
+char* platform_local_storage_get(const char* key); // You own the memory!
+
+/**
+ * Jobs run on worker threads, so they can only touch memory nobody else writes to until they are done.
+ * Without workers (single core, emscripten) jobs run right away on the calling thread.
+ */
+typedef void (*Platform_Job)(void* data, u32 index);
+
+u32 platform_get_num_workers();
+void platform_run_job(Platform_Job job, void* data); // Doesn't wait, the job has to signal when it's done
+void platform_run_jobs_and_wait(Platform_Job job, void* data, u32 num_jobs); // Calls job for every index below num_jobs
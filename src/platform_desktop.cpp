@@ -2,34 +2,72 @@
 #include <SDL2/SDL_opengl.h>
 #include <curl/curl.h>
 #include <lodepng.h>
+#include <atomic>
 #include "common.h"
 #include "platform.h"
 #include "renderer.h"
 #include "main.h"
+#include "tracing.h"
+#include "temporary_storage.h"
 
 enum Request_Type {
     Request_Type_API,
-    Request_Type_Load_Image
+    Request_Type_Load_Image,
+    Request_Type_Load_File
 };
 
+static const u32 max_slab_requests = 128;
+static const u32 inline_url_capacity = 512;
+
+// Set instead of an http status when curl fails, so the request still gets cleaned up
+static const u32 request_failed_status = 1;
+
 struct Running_Request {
     u32 status_code_or_zero;
     Request_Type request_type;
     Request_Id request_id;
-    char* debug_url = NULL;
+    char* url = NULL; // Points to inline_url unless the url didn't fit there
     char* data_read = NULL;
     u32 data_length = 0;
     u64 started_at = 0;
     void* data = NULL;
+    char inline_url[inline_url_capacity];
 };
 
 static SDL_Window* application_window = NULL;
 static SDL_GLContext gl_context;
 
+// Requests come from the slab, only when all of it is in use we go to the heap
+static Running_Request request_slab[max_slab_requests];
+static u32 free_slab_slots[max_slab_requests];
+static u32 num_free_slab_slots = 0;
+static u32 num_heap_requests = 0;
+
 static Running_Request** running_requests = NULL;
 static u32 num_running_requests = 0;
+static u32 running_requests_watermark = 0;
 static SDL_mutex* requests_process_mutex = NULL;
 
+struct Worker_Job {
+    Platform_Job job;
+    void* data;
+    u32 index;
+    std::atomic<u32>* jobs_left; // NULL when nobody waits for the job
+};
+
+// One queue for all workers, a thread which waits for its jobs runs queued ones in the meantime
+static SDL_mutex* worker_queue_mutex = NULL;
+static SDL_cond* worker_job_queued = NULL;
+static SDL_cond* worker_job_finished = NULL;
+static Worker_Job* worker_queue = NULL; // Ring buffer
+static u32 worker_queue_first = 0;
+static u32 worker_queue_length = 0;
+static u32 worker_queue_capacity = 0;
+static u32 num_workers = 0;
+
+// Same for every api request, so built once by init_requests_if_necessary
+static curl_slist* api_request_headers = NULL;
+
 static Uint64 application_time = 0;
 static bool mouse_pressed[3] = { false, false, false };
 
@@ -218,6 +256,8 @@ static void process_completed_image_request(Running_Request* request) {
 
     if (error) {
         printf("Error while decoding PNG: %u\n", error);
+
+        image_load_failure(request->request_id);
     } else {
         image_load_success(request->request_id, pixels, width, height);
     }
@@ -225,6 +265,74 @@ static void process_completed_image_request(Running_Request* request) {
     FREE(request->data_read);
 }
 
+// init() sends its first requests before platform_init, so this runs on whichever comes first
+static void init_requests_if_necessary() {
+    if (requests_process_mutex) {
+        return;
+    }
+
+    requests_process_mutex = SDL_CreateMutex();
+
+    for (u32 slot = 0; slot < max_slab_requests; slot++) {
+        free_slab_slots[num_free_slab_slots++] = max_slab_requests - slot - 1;
+    }
+
+    api_request_headers = curl_slist_append(api_request_headers, "Accept: application/json");
+
+    if (get_private_token()) {
+        api_request_headers = curl_slist_append(api_request_headers, get_private_token());
+    }
+}
+
+static Running_Request* acquire_request(Request_Type request_type, Request_Id request_id, u32 url_length) {
+    Running_Request* request;
+
+    init_requests_if_necessary();
+
+    SDL_LockMutex(requests_process_mutex);
+
+    if (num_free_slab_slots) {
+        request = &request_slab[free_slab_slots[--num_free_slab_slots]];
+    } else {
+        request = (Running_Request*) MALLOC(sizeof(Running_Request));
+        num_heap_requests++;
+
+        printf("Request slab is full, %i requests are on the heap now\n", num_heap_requests);
+    }
+
+    SDL_UnlockMutex(requests_process_mutex);
+
+    request->status_code_or_zero = 0;
+    request->request_type = request_type;
+    request->request_id = request_id;
+    request->data_read = NULL;
+    request->data_length = 0;
+    request->started_at = SDL_GetPerformanceCounter();
+    request->data = NULL;
+
+    if (url_length < inline_url_capacity) {
+        request->url = request->inline_url;
+    } else {
+        request->url = (char*) MALLOC(url_length + 1);
+    }
+
+    return request;
+}
+
+// Should be called with requests_process_mutex locked
+static void release_request(Running_Request* request) {
+    if (request->url != request->inline_url) {
+        FREE(request->url);
+    }
+
+    if (request >= request_slab && request < request_slab + max_slab_requests) {
+        free_slab_slots[num_free_slab_slots++] = (u32) (request - request_slab);
+    } else {
+        FREE(request);
+        num_heap_requests--;
+    }
+}
+
 static void process_completed_requests() {
     SDL_LockMutex(requests_process_mutex);
 
@@ -247,6 +355,12 @@ static void process_completed_requests() {
 
                         break;
                     }
+
+                    case Request_Type_Load_File: {
+                        file_load_finished(request->request_id, request->data_read, request->data_length);
+
+                        break;
+                    }
                 }
 
                 u64 delta = SDL_GetPerformanceCounter() - start_process_request;
@@ -254,11 +368,19 @@ static void process_completed_requests() {
                 printf("Request #%i processed in %.3fms\n", request->request_id, delta * 1000.0 / SDL_GetPerformanceFrequency());
             } else {
                 printf("%.*s\n", request->data_length, request->data_read);
+
+                if (request->request_type == Request_Type_Load_Image) {
+                    image_load_failure(request->request_id);
+                }
+
+                // No receiver to give it to
+                if (request->data_read) {
+                    FREE(request->data_read);
+                }
             }
 
             // data_read is managed by receiver
-            FREE(request->debug_url);
-            FREE(request);
+            release_request(request);
 
             if (num_running_requests > 1) {
                 running_requests[index] = running_requests[num_running_requests - 1];
@@ -272,6 +394,145 @@ static void process_completed_requests() {
     SDL_UnlockMutex(requests_process_mutex);
 }
 
+// Both expect worker_queue_mutex to be locked
+static void push_worker_job(Worker_Job job) {
+    if (worker_queue_length == worker_queue_capacity) {
+        u32 new_capacity = MAX(worker_queue_capacity * 2, 64);
+        Worker_Job* new_queue = (Worker_Job*) MALLOC(sizeof(Worker_Job) * new_capacity);
+
+        for (u32 index = 0; index < worker_queue_length; index++) {
+            new_queue[index] = worker_queue[(worker_queue_first + index) % worker_queue_capacity];
+        }
+
+        if (worker_queue) {
+            FREE(worker_queue);
+        }
+
+        worker_queue = new_queue;
+        worker_queue_first = 0;
+        worker_queue_capacity = new_capacity;
+    }
+
+    worker_queue[(worker_queue_first + worker_queue_length++) % worker_queue_capacity] = job;
+}
+
+static bool pop_worker_job(Worker_Job& job) {
+    if (!worker_queue_length) {
+        return false;
+    }
+
+    job = worker_queue[worker_queue_first];
+
+    worker_queue_first = (worker_queue_first + 1) % worker_queue_capacity;
+    worker_queue_length--;
+
+    return true;
+}
+
+static void run_worker_job(Worker_Job& job) {
+    job.job(job.data, job.index);
+
+    if (job.jobs_left && --*job.jobs_left == 0) {
+        SDL_LockMutex(worker_queue_mutex);
+        SDL_CondBroadcast(worker_job_finished);
+        SDL_UnlockMutex(worker_queue_mutex);
+    }
+}
+
+static int worker_thread(void*) {
+    SDL_LockMutex(worker_queue_mutex);
+
+    while (true) {
+        Worker_Job job;
+
+        if (pop_worker_job(job)) {
+            SDL_UnlockMutex(worker_queue_mutex);
+            run_worker_job(job);
+            clear_temporary_storage();
+            SDL_LockMutex(worker_queue_mutex);
+        } else {
+            // Workers never exit, so an idle one gives its temporary storage back instead
+            SDL_UnlockMutex(worker_queue_mutex);
+            release_temporary_storage();
+            SDL_LockMutex(worker_queue_mutex);
+
+            if (!worker_queue_length) {
+                SDL_CondWait(worker_job_queued, worker_queue_mutex);
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void start_workers() {
+    worker_queue_mutex = SDL_CreateMutex();
+    worker_job_queued = SDL_CreateCond();
+    worker_job_finished = SDL_CreateCond();
+
+    // The main thread is busy with the UI, so it doesn't count
+    num_workers = (u32) MAX(SDL_GetCPUCount() - 1, 0);
+
+    // Workers live as long as the app, nobody waits for them
+    for (u32 worker = 0; worker < num_workers; worker++) {
+        SDL_Thread* thread = SDL_CreateThread(worker_thread, "Worker", NULL);
+        SDL_DetachThread(thread);
+    }
+}
+
+u32 platform_get_num_workers() {
+    return num_workers;
+}
+
+void platform_run_job(Platform_Job job, void* data) {
+    if (!num_workers) {
+        job(data, 0);
+        return;
+    }
+
+    SDL_LockMutex(worker_queue_mutex);
+
+    push_worker_job({ job, data, 0, NULL });
+
+    SDL_CondSignal(worker_job_queued);
+    SDL_UnlockMutex(worker_queue_mutex);
+}
+
+void platform_run_jobs_and_wait(Platform_Job job, void* data, u32 num_jobs) {
+    if (!num_workers || num_jobs == 1) {
+        for (u32 index = 0; index < num_jobs; index++) {
+            job(data, index);
+        }
+
+        return;
+    }
+
+    std::atomic<u32> jobs_left(num_jobs);
+
+    SDL_LockMutex(worker_queue_mutex);
+
+    for (u32 index = 0; index < num_jobs; index++) {
+        push_worker_job({ job, data, index, &jobs_left });
+    }
+
+    SDL_CondBroadcast(worker_job_queued);
+
+    // Waiting from a worker would take that worker out of the pool, so we run queued jobs instead
+    while (jobs_left) {
+        Worker_Job next;
+
+        if (pop_worker_job(next)) {
+            SDL_UnlockMutex(worker_queue_mutex);
+            run_worker_job(next);
+            SDL_LockMutex(worker_queue_mutex);
+        } else if (jobs_left) {
+            SDL_CondWait(worker_job_finished, worker_queue_mutex);
+        }
+    }
+
+    SDL_UnlockMutex(worker_queue_mutex);
+}
+
 bool platform_init() {
     SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_EVENTS);
 
@@ -283,7 +544,9 @@ bool platform_init() {
 
     setup_io();
 
-    requests_process_mutex = SDL_CreateMutex();
+    init_requests_if_necessary();
+
+    start_workers();
 
     // TODO bad API, we shouldn't be making external calls in platform impl, move those out
     renderer_init(vertex_shader_source, fragment_shader_source);
@@ -370,6 +633,9 @@ static size_t handle_curl_write(char *ptr, size_t size, size_t nmemb, void *user
 
     u32 received_data_length = size * nmemb;
 
+    // Runs on the curl thread, so this doesn't interfere with whatever the main thread is tagging
+    set_memory_tag(request->request_type == Request_Type_API ? Memory_Tag_Json : Memory_Tag_Images);
+
     // TODO very inefficient
     request->data_read = (char*) REALLOC(request->data_read, request->data_length + received_data_length);
     memcpy(request->data_read + request->data_length, ptr, received_data_length);
@@ -386,6 +652,11 @@ int curl_thread_request(void* data) {
 
     if (result != CURLE_OK) {
         printf("curl_easy_perform() failed: %s\n", curl_easy_strerror(result));
+
+        Running_Request* request = NULL;
+        curl_easy_getinfo(curl, CURLINFO_PRIVATE, &request);
+
+        request->status_code_or_zero = request_failed_status;
     } else {
         u32 http_status_code = 0;
 
@@ -399,7 +670,7 @@ int curl_thread_request(void* data) {
 
         float time = (float) (((double) SDL_GetPerformanceCounter() - request->started_at) / SDL_GetPerformanceFrequency());
 
-        printf("GET %s #%i completed with %i, time: %fs\n", request->debug_url, request->request_id, http_status_code, time);
+        printf("GET %s #%i completed with %i, time: %fs\n", request->url, request->request_id, http_status_code, time);
 
         double total, name, conn, app, pre, start;
         curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total);
@@ -432,7 +703,11 @@ static void push_request(Running_Request* request) {
 
     // TODO I have a feeling this could just be an atomic write and we could get rid of a mutex altogether
     u32 new_request_index = num_running_requests++;
-    running_requests = (Running_Request**) REALLOC(running_requests, num_running_requests * sizeof(Running_Request*));
+
+    if (num_running_requests > running_requests_watermark) {
+        running_requests_watermark = MAX(running_requests_watermark * 2, max_slab_requests);
+        running_requests = (Running_Request**) REALLOC(running_requests, running_requests_watermark * sizeof(Running_Request*));
+    }
 
     running_requests[new_request_index] = request;
 
@@ -444,16 +719,11 @@ void platform_load_remote_image(Request_Id request_id, char* full_url) {
 
     u32 url_length = strlen(full_url);
 
-    Running_Request* new_request = (Running_Request*) CALLOC(1, sizeof(Running_Request));
-    new_request->request_type = Request_Type_Load_Image;
-    new_request->status_code_or_zero = 0;
-    new_request->request_id = request_id;
-    new_request->debug_url = (char*) MALLOC(url_length + 1);
-    new_request->started_at = SDL_GetPerformanceCounter();
-    strcpy(new_request->debug_url, full_url);
+    Running_Request* new_request = acquire_request(Request_Type_Load_Image, request_id, url_length);
+    memcpy(new_request->url, full_url, url_length + 1);
 
     CURL* curl_easy = curl_easy_init();
-    curl_easy_setopt(curl_easy, CURLOPT_URL, new_request->debug_url);
+    curl_easy_setopt(curl_easy, CURLOPT_URL, new_request->url);
     curl_easy_setopt(curl_easy, CURLOPT_PRIVATE, new_request);
     curl_easy_setopt(curl_easy, CURLOPT_WRITEDATA, new_request);
     curl_easy_setopt(curl_easy, CURLOPT_WRITEFUNCTION, &handle_curl_write);
@@ -468,28 +738,15 @@ void platform_api_request(Request_Id request_id, char* url, Http_Method method,
     printf("Requested api get for %i/%s\n", request_id, url);
 
     const char* url_prefix = "https://www.wrike.com/api/v3/";
-    const u32 buffer_length = strlen(url_prefix) + strlen(url) + 1;
-    char* buffer = (char*) talloc(buffer_length);
-    snprintf(buffer, buffer_length, "%s%s", url_prefix, url);
-
-    // TODO cleanup those
-    curl_slist* header_chunk = NULL;
-    header_chunk = curl_slist_append(header_chunk, "Accept: application/json");
-    header_chunk = curl_slist_append(header_chunk, get_private_token());
-
-    // TODO optimize
-    Running_Request* new_request = (Running_Request*) CALLOC(1, sizeof(Running_Request));
-    new_request->request_type = Request_Type_API;
-    new_request->status_code_or_zero = 0;
-    new_request->request_id = request_id;
-    new_request->debug_url = (char*) MALLOC(buffer_length);
-    new_request->started_at = SDL_GetPerformanceCounter();
+    const u32 url_length = strlen(url_prefix) + strlen(url);
+
+    Running_Request* new_request = acquire_request(Request_Type_API, request_id, url_length);
     new_request->data = data;
-    memcpy(new_request->debug_url, buffer, buffer_length);
+    snprintf(new_request->url, url_length + 1, "%s%s", url_prefix, url);
 
     CURL* curl_easy = curl_easy_init();
-    curl_easy_setopt(curl_easy, CURLOPT_URL, new_request->debug_url);
-    curl_easy_setopt(curl_easy, CURLOPT_HTTPHEADER, header_chunk);
+    curl_easy_setopt(curl_easy, CURLOPT_URL, new_request->url);
+    curl_easy_setopt(curl_easy, CURLOPT_HTTPHEADER, api_request_headers);
     curl_easy_setopt(curl_easy, CURLOPT_PRIVATE, new_request);
     curl_easy_setopt(curl_easy, CURLOPT_WRITEDATA, new_request);
     curl_easy_setopt(curl_easy, CURLOPT_WRITEFUNCTION, &handle_curl_write);
@@ -504,6 +761,83 @@ void platform_api_request(Request_Id request_id, char* url, Http_Method method,
     SDL_CreateThread(curl_thread_request, "CURLThread", curl_easy);
 }
 
+static int file_thread_request(void* data) {
+    Running_Request* request = (Running_Request*) data;
+
+    FILE* file_handle = fopen(request->url, "rb");
+
+    char* content = NULL;
+    u32 content_length = 0;
+
+    if (file_handle) {
+        fseek(file_handle, 0, SEEK_END);
+        s32 size = ftell(file_handle);
+
+        if (size > 0) {
+            rewind(file_handle);
+
+            content = (char*) MALLOC(size);
+            content_length = (u32) fread(content, 1, size, file_handle);
+        }
+
+        fclose(file_handle);
+    }
+
+    SDL_LockMutex(requests_process_mutex);
+
+    request->data_read = content;
+    request->data_length = content_length;
+
+    // Missing file is not an error, receiver gets NULL content instead
+    request->status_code_or_zero = 200;
+
+    SDL_UnlockMutex(requests_process_mutex);
+
+    return 0;
+}
+
+void platform_load_file(Request_Id request_id, const char* path) {
+    printf("Requested file load for %i/%s\n", request_id, path);
+
+    u32 path_length = strlen(path);
+
+    Running_Request* new_request = acquire_request(Request_Type_Load_File, request_id, path_length);
+    memcpy(new_request->url, path, path_length + 1);
+
+    push_request(new_request);
+
+    SDL_CreateThread(file_thread_request, "FileThread", new_request);
+}
+
+void platform_write_file(const char* path, void* data, u32 data_length, bool append) {
+    FILE* file_handle = fopen(path, append ? "ab" : "wb");
+
+    if (!file_handle) {
+        printf("Error opening %s for writing\n", path);
+        return;
+    }
+
+    fwrite(data, 1, data_length, file_handle);
+    fclose(file_handle);
+}
+
+bool platform_read_file_range(const char* path, u32 offset, void* data, u32 data_length) {
+    FILE* file_handle = fopen(path, "rb");
+
+    if (!file_handle) {
+        printf("Error opening %s for reading\n", path);
+        return false;
+    }
+
+    bool read_everything =
+            fseek(file_handle, offset, SEEK_SET) == 0 &&
+            fread(data, 1, data_length, file_handle) == data_length;
+
+    fclose(file_handle);
+
+    return read_everything;
+}
+
 // TODO super duper temporary coderino
 void platform_local_storage_set(const char* key, String value) {
     FILE* file_handle = fopen(key, "w");
@@ -291,6 +291,18 @@ void platform_load_remote_image(Request_Id request_id, char* full_url) {
     EM_ASM({ load_image(Pointer_stringify($0), $1) }, &full_url[0], request_id);
 }
 
+// TODO no persistent file system on the web yet, everything lives in memory for the duration of the session
+void platform_load_file(Request_Id request_id, const char* path) {
+    file_load_finished(request_id, NULL, 0);
+}
+
+void platform_write_file(const char* path, void* data, u32 data_length, bool append) {
+}
+
+bool platform_read_file_range(const char* path, u32 offset, void* data, u32 data_length) {
+    return false;
+}
+
 void platform_api_request(Request_Id request_id, char* url, Http_Method method, void* data) {
     const s8* method_as_string;
     switch (method) {
@@ -349,4 +361,19 @@ float platform_get_delta_time_ms(u64 delta_to) {
     memcpy(&double_delta_to, &delta_to, sizeof(u64));
 
     return (float) (now - double_delta_to);
-}
\ No newline at end of file
+}
+
+// There are no pthreads in our emscripten build, so jobs run on the main thread
+u32 platform_get_num_workers() {
+    return 0;
+}
+
+void platform_run_job(Platform_Job job, void* data) {
+    job(data, 0);
+}
+
+void platform_run_jobs_and_wait(Platform_Job job, void* data, u32 num_jobs) {
+    for (u32 index = 0; index < num_jobs; index++) {
+        job(data, index);
+    }
+}
@@ -378,26 +378,6 @@ void destructively_strip_html_comments(String& text) {
     text.length = (u32) (text_end - text.start);
 }
 
-void destructively_replace_escaped_quotes_with_just_quotes(String& text) {
-    char previous_character = '\0';
-    char* text_end = text.start + text.length;
-
-    for (char* current = text.start; current < text_end; current++) {
-        char this_character = *current;
-
-        if (previous_character == '\\' && this_character == '\"') {
-            memmove(current - 1, current, text_end - current);
-
-            current--;
-            text_end--;
-        }
-
-        previous_character = *current;
-    }
-
-    text.length = (u32) (text_end - text.start);
-}
-
 static Array<Rich_Text_String> parse_string_into_rich_text_string_array(String text) {
     List<Rich_Text_Token> tokens{};
     parse_text_into_tokens(text, tokens);
@@ -445,7 +425,6 @@ Rich_Text parse_string_into_temporary_rich_text(String text) {
     text = tprintf("%.*s", text.length, text.start);
 
     destructively_strip_html_comments(text);
-    destructively_replace_escaped_quotes_with_just_quotes(text);
 
     Array<Rich_Text_String> temporary_strings = parse_string_into_rich_text_string_array(text);
 
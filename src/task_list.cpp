@@ -1,5 +1,6 @@
 #include <jsmn.h>
 #include <cstdio>
+#include <atomic>
 #include <imgui.h>
 #include "id_hash_map.h"
 #include "json.h"
@@ -7,10 +8,13 @@
 #include "accounts.h"
 #include "main.h"
 #include "lazy_array.h"
+#include "handle_pool.h"
 #include "platform.h"
 #include "users.h"
+#include "tasks.h"
 #include "workflows.h"
 #include "task_view.h"
+#include "interned_strings.h"
 #include "renderer.h"
 #include "ui.h"
 
@@ -25,53 +29,90 @@ enum Task_List_Sort_Field {
     Task_List_Sort_Field_Custom_Field
 };
 
-struct Folder_Task {
-    Task_Id id;
-    Custom_Status_Id custom_status_id;
-    u32 custom_status_id_hash;
-
-    String title;
-    Relative_Pointer<Custom_Field_Value> custom_field_values;
-    u32 num_custom_field_values;
-
-    Relative_Pointer<Folder_Id> parent_folder_ids;
-    u32 num_parent_folder_ids;
-
-    Relative_Pointer<Task_Id> parent_task_ids;
-    u32 num_parent_task_ids;
+typedef char Sort_Direction;
+static const Sort_Direction Sort_Direction_Normal = 1;
+static const Sort_Direction Sort_Direction_Reverse = -1;
 
-    Relative_Pointer<User_Id> assignees;
-    u32 num_assignees;
+// Only needed until the task tree is built, everything else about a task is in task_columns
+struct Folder_Task {
+    Range_Handle<Folder_Id> parent_folder_ids;
+    Range_Handle<Task_Id> parent_task_ids;
 };
 
 struct Folder_Header {
     Folder_Id id;
     String name;
-    Custom_Field_Id* custom_columns;
+    Entity_Index* custom_columns;
     u32 num_custom_columns;
 };
 
-struct Sorted_Folder_Task {
-    Task_Id id;
-    u32 id_hash;
-
-    Folder_Task* source_task;
-    Custom_Status* cached_status;
-    User* cached_first_assignee;
-    Sorted_Folder_Task** sub_tasks; // TODO Array<Sorted_Folder_Task*>
-    u32 num_sub_tasks;
-
-    bool is_expanded;
+/**
+ * Everything sorting, filtering and flattening passes look at, one array per attribute and indexed by
+ *  task index, same as folder_tasks. A pass over statuses then only reads statuses.
+ *
+ * Title, status and assignees are copied out of task_store when its versions change,
+ *  sort keys are extracted for every sort.
+ */
+struct Folder_Task_Columns {
+    Task_Id* ids;
+    Entity_Index* summaries; // In task_store
+    u32* summary_versions;
+    Entity_Index* statuses;
+    Entity_Index* first_assignees;
+    String* titles;
+    u64* title_keys;
+    bool* is_active;
+
+    u64* sort_keys;
+    bool* has_sort_key; // Tasks without a value go last in both directions
+
+    // Task tree, sub tasks of a task are a range in the sub_tasks array
+    u32* sub_tasks_offsets;
+    u32* num_sub_tasks;
+    bool* is_expanded;
 };
 
 struct Flattened_Folder_Task {
-    Sorted_Folder_Task* sorted_task;
+    u32 task;
     u32 nesting_level;
     u32 num_visible_sub_tasks;
 
     bool needs_sub_task_sort;
 };
 
+// Everything comparing two top level tasks needs is copied in, workers sorting them don't read task_columns
+struct Task_Sort_Entry {
+    u64 key; // Flipped for the reverse direction
+    u32 task;
+    s32 id;
+    bool has_key;
+};
+
+/**
+ * Big folders sort their top level tasks on workers, while the table keeps showing the previous order.
+ *
+ * Entries are split into a chunk per worker, chunks are sorted in parallel then merged pairwise,
+ *  each round of merges also in parallel. Only one sort runs at a time, one asked for in the meantime
+ *  starts when the running one is done and the result of the running one is thrown away.
+ */
+struct Top_Level_Sort {
+    Task_Sort_Entry* entries;
+    Task_Sort_Entry* merged_entries;
+    u32 entries_capacity;
+    u32 num_entries;
+
+    String* strings; // By task index, behind keys which are string prefixes
+    u32 strings_capacity;
+    bool compares_strings;
+
+    Sort_Direction direction;
+    u32 num_chunks;
+    u32 merge_width; // In chunks, for the current round of merges
+
+    u32 folder_version;
+    u64 started_at;
+};
+
 struct Table_Paint_Context {
     ImDrawList* draw_list;
     Custom_Field** column_to_custom_field;
@@ -81,208 +122,371 @@ struct Table_Paint_Context {
     float text_padding_y;
 };
 
-typedef int (Comparator)(const void*, const void*);
-
 static const u32 custom_columns_start_index = 3;
+static const u32 NO_FOLDER_TASK = (u32) -1;
+
+// Below that a sort takes about as long as handing it over to workers
+static const u32 min_tasks_for_parallel_sort = 8192;
 
 static Folder_Header current_folder{};
 
 static Array<Folder_Task> folder_tasks{};
-static Sorted_Folder_Task* sorted_folder_tasks = NULL;
+static Folder_Task_Columns task_columns{};
+static u32 task_columns_capacity = 0;
 static Array<Flattened_Folder_Task> flattened_sorted_folder_task_tree{};
-static Lazy_Array<Sorted_Folder_Task*, 32> top_level_tasks{};
+static Lazy_Array<u32, 32> top_level_tasks{};
 
-static Id_Hash_Map<Task_Id, Sorted_Folder_Task*> id_to_sorted_folder_task{};
+static Id_Hash_Map<Task_Id, u32, NO_FOLDER_TASK> id_to_folder_task{};
 
-static Lazy_Array<Custom_Field_Value, 16> custom_field_values{};
-static Lazy_Array<Task_Id, 16> parent_task_ids{};
-static Lazy_Array<User_Id, 16> assignee_ids{};
-static Sorted_Folder_Task** sub_tasks = NULL;
+// All of those are reset when a new folder is loaded
 
-typedef char Sort_Direction;
-static const Sort_Direction Sort_Direction_Normal = 1;
-static const Sort_Direction Sort_Direction_Reverse = -1;
+// Custom field values by custom field entity index, then by task index, NULL for fields no task here has a value for
+static Array<Custom_Field_Value*> custom_field_columns{};
+static u32 custom_field_column_length = 0;
+static Range_Pool<Folder_Id> parent_folder_ids{};
+static Range_Pool<Task_Id> parent_task_ids{};
+static u32* sub_tasks = NULL;
 
 static Task_List_Sort_Field sort_field = Task_List_Sort_Field_None;
 static Custom_Field_Id sort_custom_field_id{};
 static Custom_Field* sort_custom_field;
 static Sort_Direction sort_direction = Sort_Direction_Normal;
+static Entity_Index sort_custom_field_index = NO_ENTITY;
+static bool sort_key_is_string_prefix = false;
 static bool has_been_sorted_after_loading = false;
 static bool show_only_active_tasks = true;
 static bool queue_flattened_tree_rebuild = false;
+static u32 seen_task_store_version = 0;
+static u32 folder_contents_version = 0;
 
-static inline int compare_tasks_custom_fields(Folder_Task* a, Folder_Task* b, Custom_Field_Type custom_field_type) {
-    String* a_value = NULL;
-    String* b_value = NULL;
+static Top_Level_Sort top_level_sort{};
+static bool is_top_level_sort_running = false;
+static bool is_top_level_sort_queued = false;
+static std::atomic<bool> is_top_level_sort_done(false);
 
-    // TODO we could cache that to sort big lists faster
-    for (u32 index = 0; index < a->num_custom_field_values; index++) {
-        if (a->custom_field_values[index].field_id == sort_custom_field_id) {
-            a_value = &a->custom_field_values[index].value;
-            break;
-        }
-    }
+// Shown in the memory debug view, to see how task storage changes affect the table
+static float last_table_draw_time_ms = 0.0f;
+static float slowest_table_draw_time_ms = 0.0f;
+static float last_sort_time_ms = 0.0f;
+static u32 last_table_draw_num_rows = 0;
 
-    if (!a_value) {
-        return 1;
-    }
+// Packed big endian, so comparing keys orders strings the way memcmp would, up to their first 8 bytes
+static inline u64 string_to_sort_key(String string) {
+    u64 key = 0;
 
-    for (u32 index = 0; index < b->num_custom_field_values; index++) {
-        if (b->custom_field_values[index].field_id == sort_custom_field_id) {
-            b_value = &b->custom_field_values[index].value;
-            break;
+    for (u32 index = 0; index < sizeof(u64); index++) {
+        key <<= 8;
+
+        if (index < string.length) {
+            key |= (u8) string.start[index];
         }
     }
 
-    if (!b_value) {
-        return -1;
-    }
+    return key;
+}
 
-    switch (custom_field_type) {
-        case Custom_Field_Type_Numeric: {
-            return string_atoi(a_value) - string_atoi(b_value);
-        }
+// Flips the sign bit, so negative numbers come before positive ones when compared unsigned
+static inline u64 signed_to_sort_key(s64 value) {
+    return (u64) value ^ (1ull << 63);
+}
 
-        case Custom_Field_Type_DropDown:
-        case Custom_Field_Type_Text: {
-            return strncmp(a_value->start, b_value->start, MIN(a_value->length, b_value->length));
-        }
+// Sign bit flipped for positives and all bits for negatives, then doubles compare as unsigned integers
+static inline u64 double_to_sort_key(double value) {
+    u64 bits;
+    memcpy(&bits, &value, sizeof(bits));
 
-        default: {
-            return 0;
-        }
-    }
+    return bits & (1ull << 63) ? ~bits : bits ^ (1ull << 63);
 }
 
-static int compare_folder_tasks_based_on_title(const void* ap, const void* bp) {
-    Sorted_Folder_Task* as = *(Sorted_Folder_Task**) ap;
-    Sorted_Folder_Task* bs = *(Sorted_Folder_Task**) bp;
+static inline int compare_strings(String a, String b) {
+    int result = memcmp(a.start, b.start, MIN(a.length, b.length));
 
-    Folder_Task* a = as->source_task;
-    Folder_Task* b = bs->source_task;
+    if (!result) {
+        return (int) a.length - (int) b.length;
+    }
 
-    int result = strncmp(a->title.start, b->title.start, MIN(a->title.length, b->title.length)) * sort_direction;
+    return result;
+}
 
-    if (result == 0) {
-        return (int) (as->source_task->id - bs->source_task->id);
+template <typename T>
+static inline void reserve_task_column(T*& column, u32 capacity) {
+    column = (T*) REALLOC(column, sizeof(T) * capacity);
+}
+
+static void reserve_task_columns(u32 capacity) {
+    if (task_columns_capacity >= capacity) {
+        return;
     }
 
-    return result;
+    reserve_task_column(task_columns.ids, capacity);
+    reserve_task_column(task_columns.summaries, capacity);
+    reserve_task_column(task_columns.summary_versions, capacity);
+    reserve_task_column(task_columns.statuses, capacity);
+    reserve_task_column(task_columns.first_assignees, capacity);
+    reserve_task_column(task_columns.titles, capacity);
+    reserve_task_column(task_columns.title_keys, capacity);
+    reserve_task_column(task_columns.is_active, capacity);
+    reserve_task_column(task_columns.sort_keys, capacity);
+    reserve_task_column(task_columns.has_sort_key, capacity);
+    reserve_task_column(task_columns.sub_tasks_offsets, capacity);
+    reserve_task_column(task_columns.num_sub_tasks, capacity);
+    reserve_task_column(task_columns.is_expanded, capacity);
+
+    task_columns_capacity = capacity;
 }
 
-static int compare_folder_tasks_based_on_assignees(const void* ap, const void* bp) {
-    Sorted_Folder_Task* as = *(Sorted_Folder_Task**) ap;
-    Sorted_Folder_Task* bs = *(Sorted_Folder_Task**) bp;
+static inline Task_Summary* get_folder_task_summary(u32 task) {
+    return get_task_summary(task_columns.summaries[task]);
+}
+
+static inline Custom_Field_Value* get_custom_field_column(Entity_Index field) {
+    return field < custom_field_columns.length ? custom_field_columns[field] : NULL;
+}
 
-    User* a_assignee = as->cached_first_assignee;
+static Custom_Field_Value* get_or_add_custom_field_column(Entity_Index field) {
+    if (field >= custom_field_columns.length) {
+        u32 new_length = field + 1;
 
-    if (!a_assignee) {
-        return 1;
+        custom_field_columns.data = (Custom_Field_Value**) REALLOC(custom_field_columns.data, sizeof(Custom_Field_Value*) * new_length);
+        memset(custom_field_columns.data + custom_field_columns.length, 0, sizeof(Custom_Field_Value*) * (new_length - custom_field_columns.length));
+        custom_field_columns.length = new_length;
     }
 
-    User* b_assignee = bs->cached_first_assignee;
+    Custom_Field_Value*& column = custom_field_columns[field];
 
-    if (!b_assignee) {
-        return -1;
+    if (!column) {
+        // Zeroed values are Custom_Field_Value_Kind_None, for tasks which don't have one
+        column = (Custom_Field_Value*) CALLOC(custom_field_column_length, sizeof(Custom_Field_Value));
     }
 
-    temporary_storage_mark();
+    return column;
+}
 
-    String a_name = full_user_name_to_temporary_string(a_assignee);
-    String b_name = full_user_name_to_temporary_string(b_assignee);
+static void reset_custom_field_columns(u32 num_tasks) {
+    for (u32 index = 0; index < custom_field_columns.length; index++) {
+        if (custom_field_columns[index]) {
+            FREE(custom_field_columns[index]);
+        }
+    }
+
+    custom_field_columns.length = 0;
+    custom_field_column_length = num_tasks;
+}
 
-    s32 result = strncmp(a_name.start, b_name.start, MIN(a_name.length, b_name.length)) * sort_direction;
+static inline bool is_sort_key_a_string_prefix() {
+    switch (sort_field) {
+        case Task_List_Sort_Field_Title: {
+            return true;
+        }
 
-    temporary_storage_reset();
+        case Task_List_Sort_Field_Custom_Field: {
+            return sort_custom_field->type == Custom_Field_Type_Text || sort_custom_field->type == Custom_Field_Type_DropDown;
+        }
 
-    if (result == 0) {
-        return (int) (as->source_task->id - bs->source_task->id);
+        default: {
+            return false;
+        }
     }
+}
 
-    return result;
+struct User_Sort_Name {
+    String name;
+    Entity_Index user;
+};
+
+static int compare_user_sort_names(const void* ap, const void* bp) {
+    return compare_strings(((User_Sort_Name*) ap)->name, ((User_Sort_Name*) bp)->name);
 }
 
-static int compare_folder_tasks_based_on_status(const void* ap, const void* bp) {
-    Sorted_Folder_Task* as = *(Sorted_Folder_Task**) ap;
-    Sorted_Folder_Task* bs = *(Sorted_Folder_Task**) bp;
+// Many tasks share an assignee, so users are ranked by name once and tasks take the rank of their assignee
+static void extract_assignee_sort_keys() {
+    u32 num_users = user_store.registry.length;
+    u64* user_keys = (u64*) talloc(sizeof(u64) * num_users);
+    bool* has_user_key = (bool*) talloc(sizeof(bool) * num_users);
+    User_Sort_Name* names = (User_Sort_Name*) talloc(sizeof(User_Sort_Name) * num_users);
+    u32 num_names = 0;
 
-    Custom_Status* a_status = as->cached_status;
-    Custom_Status* b_status = bs->cached_status;
+    memset(has_user_key, 0, sizeof(bool) * num_users);
 
-    // TODO do status comparison based on status type?
+    for (u32 task = 0; task < folder_tasks.length; task++) {
+        Entity_Index assignee = task_columns.first_assignees[task];
+        User* user = entity_get(user_store.registry, assignee);
 
-    s32 result = a_status->natural_index - b_status->natural_index;
+        if (user && !has_user_key[assignee]) {
+            names[num_names++] = { full_user_name_to_temporary_string(user), assignee };
 
-    if (!result) {
-        result = (a_status->id - b_status->id) * sort_direction;
+            has_user_key[assignee] = true;
+        }
     }
 
-    if (!result) {
-        return (int) (as->source_task->id - bs->source_task->id);
+    qsort(names, num_names, sizeof(User_Sort_Name), compare_user_sort_names);
+
+    u64 rank = 0;
+
+    for (u32 name_index = 0; name_index < num_names; name_index++) {
+        // Same names get the same rank, those are then ordered by task id like any other tie
+        if (name_index && compare_strings(names[name_index - 1].name, names[name_index].name)) {
+            rank++;
+        }
+
+        user_keys[names[name_index].user] = rank;
     }
 
-    return result;
+    for (u32 task = 0; task < folder_tasks.length; task++) {
+        Entity_Index assignee = task_columns.first_assignees[task];
+        bool has_key = entity_get(user_store.registry, assignee) != NULL;
+
+        task_columns.has_sort_key[task] = has_key;
+        task_columns.sort_keys[task] = has_key ? user_keys[assignee] : 0;
+    }
 }
 
-static int compare_folder_tasks_based_on_custom_field(const void* ap, const void* bp) {
-    Sorted_Folder_Task* as = *(Sorted_Folder_Task**) ap;
-    Sorted_Folder_Task* bs = *(Sorted_Folder_Task**) bp;
+static void extract_custom_field_sort_keys() {
+    Custom_Field_Value* column = get_custom_field_column(sort_custom_field_index);
 
-    Folder_Task* a = as->source_task;
-    Folder_Task* b = bs->source_task;
+    for (u32 task = 0; task < folder_tasks.length; task++) {
+        Custom_Field_Value* value = column ? &column[task] : NULL;
 
-    // TODO inline that?
-    s32 result = compare_tasks_custom_fields(a, b, sort_custom_field->type) * sort_direction;
+        bool has_value = value && value->kind != Custom_Field_Value_Kind_None;
+        u64 key = 0;
 
-    if (!result) {
-        return (int) (as->source_task->id - bs->source_task->id);
-    }
+        if (has_value) {
+            switch (sort_custom_field->type) {
+                case Custom_Field_Type_Numeric:
+                case Custom_Field_Type_Currency:
+                case Custom_Field_Type_Percentage:
+                case Custom_Field_Type_Duration: {
+                    has_value = value->kind == Custom_Field_Value_Kind_Number;
+                    key = has_value ? double_to_sort_key(value->number) : 0;
+                    break;
+                }
 
-    return result;
+                case Custom_Field_Type_Date: {
+                    has_value = value->kind == Custom_Field_Value_Kind_Date;
+                    key = has_value ? signed_to_sort_key(value->date) : 0;
+                    break;
+                }
+
+                case Custom_Field_Type_Checkbox: {
+                    key = value->kind == Custom_Field_Value_Kind_Boolean && value->checked;
+                    break;
+                }
+
+                case Custom_Field_Type_DropDown:
+                case Custom_Field_Type_Text: {
+                    key = string_to_sort_key(value->value);
+                    break;
+                }
+
+                default: {}
+            }
+        }
+
+        task_columns.sort_keys[task] = key;
+        task_columns.has_sort_key[task] = has_value;
+    }
 }
 
-static inline Comparator* get_comparator_by_current_sort_type() {
+static void extract_sort_keys() {
     switch (sort_field) {
         case Task_List_Sort_Field_Title: {
-            return compare_folder_tasks_based_on_title;
-        }
+            memcpy(task_columns.sort_keys, task_columns.title_keys, sizeof(u64) * folder_tasks.length);
+            memset(task_columns.has_sort_key, 1, sizeof(bool) * folder_tasks.length);
 
-        case Task_List_Sort_Field_Assignee: {
-            return compare_folder_tasks_based_on_assignees;
+            break;
         }
 
         case Task_List_Sort_Field_Status: {
-            return compare_folder_tasks_based_on_status;
+            for (u32 task = 0; task < folder_tasks.length; task++) {
+                Custom_Status* status = entity_get(custom_status_registry, task_columns.statuses[task]);
+
+                // TODO do status comparison based on status type?
+                task_columns.sort_keys[task] = status ? ((u64) status->natural_index << 32) | ((u32) status->id.value ^ 0x80000000) : 0;
+                task_columns.has_sort_key[task] = status != NULL;
+            }
+
+            break;
+        }
+
+        case Task_List_Sort_Field_Assignee: {
+            extract_assignee_sort_keys();
+            break;
         }
 
         case Task_List_Sort_Field_Custom_Field: {
-            return compare_folder_tasks_based_on_custom_field;
+            extract_custom_field_sort_keys();
+            break;
         }
 
         default: {}
     }
+}
+
+// Only reached when both keys are the same 8 bytes of a string
+static int compare_sort_strings(u32 a, u32 b) {
+    switch (sort_field) {
+        case Task_List_Sort_Field_Title: {
+            return compare_strings(task_columns.titles[a], task_columns.titles[b]);
+        }
 
-    assert(!"Invalid sort field");
+        default: {
+            Custom_Field_Value* column = get_custom_field_column(sort_custom_field_index);
 
-    return NULL;
+            return compare_strings(column[a].value, column[b].value);
+        }
+    }
 }
 
-static u32 rebuild_flattened_task_tree_hierarchically(Sorted_Folder_Task* task, bool is_parent_expanded, u32 level, Flattened_Folder_Task** current_task) {
-    if (show_only_active_tasks && task->cached_status->group != Status_Group_Active) {
+static int compare_folder_tasks_by_sort_key(const void* ap, const void* bp) {
+    u32 a = *(u32*) ap;
+    u32 b = *(u32*) bp;
+
+    bool a_has_key = task_columns.has_sort_key[a];
+
+    if (a_has_key != task_columns.has_sort_key[b]) {
+        return a_has_key ? -1 : 1;
+    }
+
+    u64 a_key = task_columns.sort_keys[a];
+    u64 b_key = task_columns.sort_keys[b];
+
+    if (a_key != b_key) {
+        return (a_key < b_key ? -1 : 1) * sort_direction;
+    }
+
+    if (a_has_key && sort_key_is_string_prefix) {
+        int result = compare_sort_strings(a, b) * sort_direction;
+
+        if (result) {
+            return result;
+        }
+    }
+
+    s32 a_id = task_columns.ids[a].value;
+    s32 b_id = task_columns.ids[b].value;
+
+    return a_id < b_id ? -1 : a_id > b_id;
+}
+
+static u32 rebuild_flattened_task_tree_hierarchically(u32 task, bool is_parent_expanded, u32 level, Flattened_Folder_Task** current_task) {
+    if (show_only_active_tasks && !task_columns.is_active[task]) {
         return 0;
     }
 
     if (is_parent_expanded) {
         Flattened_Folder_Task* flattened_task = *current_task;
-        flattened_task->sorted_task = task;
+        flattened_task->task = task;
         flattened_task->nesting_level = level;
         flattened_task->num_visible_sub_tasks = 0;
         flattened_task->needs_sub_task_sort = true;
 
         *current_task = flattened_task + 1;
 
-        for (u32 sub_task_index = 0; sub_task_index < task->num_sub_tasks; sub_task_index++) {
-            flattened_task->num_visible_sub_tasks += rebuild_flattened_task_tree_hierarchically(task->sub_tasks[sub_task_index], task->is_expanded, level + 1, current_task);
+        u32* task_sub_tasks = sub_tasks + task_columns.sub_tasks_offsets[task];
+        bool is_expanded = task_columns.is_expanded[task];
+
+        for (u32 sub_task_index = 0; sub_task_index < task_columns.num_sub_tasks[task]; sub_task_index++) {
+            flattened_task->num_visible_sub_tasks += rebuild_flattened_task_tree_hierarchically(task_sub_tasks[sub_task_index], is_expanded, level + 1, current_task);
         }
     }
 
@@ -300,35 +504,269 @@ static void rebuild_flattened_task_tree() {
 }
 
 static void rebuild_flattened_task_subtree(Flattened_Folder_Task* starting_at) {
-    rebuild_flattened_task_tree_hierarchically(starting_at->sorted_task, true, starting_at->nesting_level, &starting_at);
+    rebuild_flattened_task_tree_hierarchically(starting_at->task, true, starting_at->nesting_level, &starting_at);
 }
 
-static void sort_sub_tasks_of_task(Sorted_Folder_Task* task) {
-    qsort(task->sub_tasks, task->num_sub_tasks, sizeof(Sorted_Folder_Task*), get_comparator_by_current_sort_type());
+static void sort_sub_tasks_of_task(u32 task) {
+    qsort(sub_tasks + task_columns.sub_tasks_offsets[task], task_columns.num_sub_tasks[task], sizeof(u32), compare_folder_tasks_by_sort_key);
 }
 
-static void sort_top_level_tasks_and_rebuild_flattened_tree() {
-    qsort(top_level_tasks.data, top_level_tasks.length, sizeof(Sorted_Folder_Task*), get_comparator_by_current_sort_type());
+// Same order as compare_folder_tasks_by_sort_key
+static inline int compare_task_sort_entries(const Task_Sort_Entry& a, const Task_Sort_Entry& b) {
+    if (a.has_key != b.has_key) {
+        return a.has_key ? -1 : 1;
+    }
+
+    if (a.key != b.key) {
+        return a.key < b.key ? -1 : 1;
+    }
+
+    if (a.has_key && top_level_sort.compares_strings) {
+        int result = compare_strings(top_level_sort.strings[a.task], top_level_sort.strings[b.task]) * top_level_sort.direction;
+
+        if (result) {
+            return result;
+        }
+    }
+
+    return a.id < b.id ? -1 : a.id > b.id;
+}
+
+static void merge_task_sort_entries(Task_Sort_Entry* left, Task_Sort_Entry* left_end, Task_Sort_Entry* right, Task_Sort_Entry* right_end, Task_Sort_Entry* output) {
+    while (left < left_end && right < right_end) {
+        if (compare_task_sort_entries(*right, *left) < 0) {
+            *output++ = *right++;
+        } else {
+            *output++ = *left++;
+        }
+    }
+
+    memcpy(output, left, sizeof(Task_Sort_Entry) * (left_end - left));
+    output += left_end - left;
+
+    memcpy(output, right, sizeof(Task_Sort_Entry) * (right_end - right));
+}
+
+// Insertion sorted runs merged bottom up, unlike qsort the comparison is inlined
+static void merge_sort_task_sort_entries(Task_Sort_Entry* entries, Task_Sort_Entry* scratch, u32 length) {
+    const u32 run_length = 16;
+
+    for (u32 run_start = 0; run_start < length; run_start += run_length) {
+        u32 run_end = MIN(run_start + run_length, length);
+
+        for (u32 index = run_start + 1; index < run_end; index++) {
+            Task_Sort_Entry entry = entries[index];
+            u32 position = index;
+
+            while (position > run_start && compare_task_sort_entries(entry, entries[position - 1]) < 0) {
+                entries[position] = entries[position - 1];
+                position--;
+            }
+
+            entries[position] = entry;
+        }
+    }
+
+    Task_Sort_Entry* source = entries;
+    Task_Sort_Entry* destination = scratch;
+
+    for (u32 width = run_length; width < length; width *= 2) {
+        for (u32 start = 0; start < length; start += width * 2) {
+            u32 middle = MIN(start + width, length);
+            u32 end = MIN(start + width * 2, length);
+
+            merge_task_sort_entries(source + start, source + middle, source + middle, source + end, destination + start);
+        }
+
+        Task_Sort_Entry* merged = destination;
+        destination = source;
+        source = merged;
+    }
+
+    if (source != entries) {
+        memcpy(entries, source, sizeof(Task_Sort_Entry) * length);
+    }
+}
+
+static inline u32 get_top_level_sort_chunk_start(u32 chunk) {
+    return (u32) ((u64) top_level_sort.num_entries * MIN(chunk, top_level_sort.num_chunks) / top_level_sort.num_chunks);
+}
+
+static void sort_top_level_sort_chunk(void*, u32 chunk) {
+    u32 start = get_top_level_sort_chunk_start(chunk);
+    u32 end = get_top_level_sort_chunk_start(chunk + 1);
+
+    merge_sort_task_sort_entries(top_level_sort.entries + start, top_level_sort.merged_entries + start, end - start);
+}
+
+static void merge_top_level_sort_chunks(void*, u32 merge) {
+    u32 first_chunk = merge * top_level_sort.merge_width * 2;
+
+    u32 start = get_top_level_sort_chunk_start(first_chunk);
+    u32 middle = get_top_level_sort_chunk_start(first_chunk + top_level_sort.merge_width);
+    u32 end = get_top_level_sort_chunk_start(first_chunk + top_level_sort.merge_width * 2);
+
+    Task_Sort_Entry* entries = top_level_sort.entries;
+
+    merge_task_sort_entries(entries + start, entries + middle, entries + middle, entries + end, top_level_sort.merged_entries + start);
+}
+
+// Runs on a worker, sorted entries end up in top_level_sort.entries
+static void run_top_level_sort(void*, u32) {
+    platform_run_jobs_and_wait(sort_top_level_sort_chunk, NULL, top_level_sort.num_chunks);
+
+    for (top_level_sort.merge_width = 1; top_level_sort.merge_width < top_level_sort.num_chunks; top_level_sort.merge_width *= 2) {
+        u32 merged_chunks = top_level_sort.merge_width * 2;
+
+        platform_run_jobs_and_wait(merge_top_level_sort_chunks, NULL, (top_level_sort.num_chunks + merged_chunks - 1) / merged_chunks);
+
+        Task_Sort_Entry* merged_entries = top_level_sort.merged_entries;
+        top_level_sort.merged_entries = top_level_sort.entries;
+        top_level_sort.entries = merged_entries;
+    }
+
+    is_top_level_sort_done = true;
+}
+
+static void start_top_level_sort() {
+    u32 num_entries = top_level_tasks.length;
+
+    if (top_level_sort.entries_capacity < num_entries) {
+        top_level_sort.entries = (Task_Sort_Entry*) REALLOC(top_level_sort.entries, sizeof(Task_Sort_Entry) * num_entries);
+        top_level_sort.merged_entries = (Task_Sort_Entry*) REALLOC(top_level_sort.merged_entries, sizeof(Task_Sort_Entry) * num_entries);
+        top_level_sort.entries_capacity = num_entries;
+    }
+
+    for (u32 entry_index = 0; entry_index < num_entries; entry_index++) {
+        u32 task = top_level_tasks[entry_index];
+        u64 key = task_columns.sort_keys[task];
+
+        Task_Sort_Entry& entry = top_level_sort.entries[entry_index];
+        entry.key = sort_direction == Sort_Direction_Normal ? key : ~key;
+        entry.task = task;
+        entry.id = task_columns.ids[task].value;
+        entry.has_key = task_columns.has_sort_key[task];
+    }
+
+    top_level_sort.compares_strings = sort_key_is_string_prefix;
+
+    // Interned strings aren't collected while the sort is running, so the copies stay valid while workers read them
+    if (sort_key_is_string_prefix) {
+        if (top_level_sort.strings_capacity < folder_tasks.length) {
+            top_level_sort.strings = (String*) REALLOC(top_level_sort.strings, sizeof(String) * folder_tasks.length);
+            top_level_sort.strings_capacity = folder_tasks.length;
+        }
+
+        if (sort_field == Task_List_Sort_Field_Title) {
+            memcpy(top_level_sort.strings, task_columns.titles, sizeof(String) * folder_tasks.length);
+        } else {
+            Custom_Field_Value* column = get_custom_field_column(sort_custom_field_index);
+
+            for (u32 task = 0; task < folder_tasks.length; task++) {
+                top_level_sort.strings[task] = column ? column[task].value : String{};
+            }
+        }
+    }
+
+    top_level_sort.num_entries = num_entries;
+    top_level_sort.num_chunks = platform_get_num_workers();
+    top_level_sort.direction = sort_direction;
+    top_level_sort.folder_version = folder_contents_version;
+    top_level_sort.started_at = platform_get_app_time_precise();
+
+    is_top_level_sort_running = true;
+    is_top_level_sort_done = false;
+
+    platform_run_job(run_top_level_sort, NULL);
+}
+
+static void finish_top_level_sort_if_done() {
+    if (!is_top_level_sort_running || !is_top_level_sort_done) {
+        return;
+    }
+
+    is_top_level_sort_running = false;
+
+    if (is_top_level_sort_queued) {
+        is_top_level_sort_queued = false;
+        start_top_level_sort();
+        return;
+    }
+
+    // Sorted tasks from a previous folder
+    if (top_level_sort.folder_version != folder_contents_version) {
+        return;
+    }
+
+    for (u32 entry_index = 0; entry_index < top_level_sort.num_entries; entry_index++) {
+        top_level_tasks[entry_index] = top_level_sort.entries[entry_index].task;
+    }
 
     rebuild_flattened_task_tree();
+
+    last_sort_time_ms = platform_get_delta_time_ms(top_level_sort.started_at);
+
+    printf("Sorting %i top level tasks on %i workers took %fms\n", top_level_sort.num_entries, top_level_sort.num_chunks, last_sort_time_ms);
 }
 
-static void update_cached_data_for_sorted_tasks() {
-    // TODO We actually only need to do that once when tasks/workflows combination changes, not for every sort
-    for (u32 index = 0; index < folder_tasks.length; index++) {
-        Sorted_Folder_Task* sorted_folder_task = &sorted_folder_tasks[index];
-        Folder_Task* source = sorted_folder_task->source_task;
+// Sub tasks are sorted when they are first shown, using the same keys
+static void sort_top_level_tasks_and_rebuild_flattened_tree() {
+    u64 start = platform_get_app_time_precise();
+
+    sort_key_is_string_prefix = is_sort_key_a_string_prefix();
 
-        sorted_folder_task->cached_status = find_custom_status_by_id(source->custom_status_id, source->custom_status_id_hash);
+    extract_sort_keys();
+
+    if (top_level_tasks.length >= min_tasks_for_parallel_sort && platform_get_num_workers()) {
+        // Until the first sort is done the table shows tasks in the order they came in
+        if (!has_been_sorted_after_loading) {
+            rebuild_flattened_task_tree();
+        }
 
-        if (source->num_assignees) {
-            sorted_folder_task->cached_first_assignee = find_user_by_id(source->assignees[0]);
+        if (is_top_level_sort_running) {
+            is_top_level_sort_queued = true;
         } else {
-            sorted_folder_task->cached_first_assignee = NULL;
+            start_top_level_sort();
         }
+
+        return;
+    }
+
+    qsort(top_level_tasks.data, top_level_tasks.length, sizeof(u32), compare_folder_tasks_by_sort_key);
+
+    rebuild_flattened_task_tree();
+
+    last_sort_time_ms = platform_get_delta_time_ms(start);
+
+    printf("Sorting %i elements by %i took %fms\n", folder_tasks.length, sort_field, last_sort_time_ms);
+}
+
+static void update_task_columns() {
+    for (u32 task = 0; task < folder_tasks.length; task++) {
+        Entity_Index summary_index = task_columns.summaries[task];
+        Task_Summary* summary = get_task_summary(summary_index);
+        Custom_Status* status = entity_get(custom_status_registry, summary->status);
+
+        task_columns.summary_versions[task] = entity_version(task_store.registry, summary_index);
+        task_columns.statuses[task] = summary->status;
+        task_columns.first_assignees[task] = summary->assignees.length ? get_task_assignees(summary)[0] : NO_ENTITY;
+        task_columns.titles[task] = summary->title;
+        task_columns.title_keys[task] = string_to_sort_key(summary->title);
+        task_columns.is_active[task] = !status || status->group == Status_Group_Active;
     }
 }
 
+// Tasks are shared with other views, a status set from the task view changes a task in the list too
+static bool have_sorted_tasks_changed() {
+    for (u32 task = 0; task < folder_tasks.length; task++) {
+        if (entity_version(task_store.registry, task_columns.summaries[task]) != task_columns.summary_versions[task]) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 static void sort_by_field(Task_List_Sort_Field sort_by) {
     assert(sort_by != Task_List_Sort_Field_Custom_Field);
 
@@ -338,72 +776,63 @@ static void sort_by_field(Task_List_Sort_Field sort_by) {
         sort_direction = Sort_Direction_Normal;
     }
 
-    update_cached_data_for_sorted_tasks();
+    update_task_columns();
 
     sort_field = sort_by;
 
-    u64 start = platform_get_app_time_precise();
     sort_top_level_tasks_and_rebuild_flattened_tree();
-    printf("Sorting %i elements by %i took %fms\n", folder_tasks.length, sort_by, platform_get_delta_time_ms(start));
 }
 
-static void sort_by_custom_field(Custom_Field_Id field_id) {
-    if (sort_field == Task_List_Sort_Field_Custom_Field && field_id == sort_custom_field_id) {
+static void sort_by_custom_field(Custom_Field* field) {
+    if (sort_field == Task_List_Sort_Field_Custom_Field && field->id == sort_custom_field_id) {
         sort_direction *= -1;
     } else {
         sort_direction = Sort_Direction_Normal;
     }
 
-    update_cached_data_for_sorted_tasks();
+    update_task_columns();
 
     sort_field = Task_List_Sort_Field_Custom_Field;
-    sort_custom_field_id = field_id;
-    sort_custom_field = find_custom_field_by_id(field_id, hash_id(field_id)); // TODO hash cache?
+    sort_custom_field_id = field->id;
+    sort_custom_field_index = entity_find(custom_field_registry, field->id);
+    sort_custom_field = field;
 
-    u64 start = platform_get_app_time_precise();
     sort_top_level_tasks_and_rebuild_flattened_tree();
-    printf("Sorting %i elements by %i took %fms\n", folder_tasks.length, field_id, platform_get_delta_time_ms(start));
 }
 
 Custom_Field** map_columns_to_custom_fields() {
     Custom_Field** column_to_custom_field = (Custom_Field**) talloc(sizeof(Custom_Field*) * current_folder.num_custom_columns);
 
     for (u32 column = 0; column < current_folder.num_custom_columns; column++) {
-        Custom_Field_Id custom_field_id = current_folder.custom_columns[column];
-
-        // TODO hash cache!
-        Custom_Field* custom_field = find_custom_field_by_id(custom_field_id, hash_id(custom_field_id));
-
-        column_to_custom_field[column] = custom_field;
+        column_to_custom_field[column] = entity_get(custom_field_registry, current_folder.custom_columns[column]);
     }
 
     return column_to_custom_field;
 }
 
-Custom_Field_Value* try_find_custom_field_value_in_task(Folder_Task* task, Custom_Field* field) {
-    if (!field) return NULL;
-
-    for (u32 index = 0; index < task->num_custom_field_values; index++) {
-        Custom_Field_Value* value = &task->custom_field_values[index];
+Custom_Field_Value* try_find_custom_field_value_in_task(u32 task, Entity_Index field) {
+    Custom_Field_Value* column = get_custom_field_column(field);
 
-        if (value->field_id == field->id) {
-            return value;
-        }
+    if (!column) {
+        return NULL;
     }
 
-    return NULL;
+    Custom_Field_Value* value = &column[task];
+
+    return value->kind == Custom_Field_Value_Kind_None ? NULL : value;
 }
 
-void draw_assignees_cell_contents(ImDrawList* draw_list, Folder_Task* task, ImVec2 text_position) {
-    for (u32 assignee_index = 0; assignee_index < task->num_assignees; assignee_index++) {
-        User_Id user_id = task->assignees[assignee_index];
-        User* user = find_user_by_id(user_id);
+void draw_assignees_cell_contents(ImDrawList* draw_list, Task_Summary* task, ImVec2 text_position) {
+    Entity_Index* task_assignees = get_task_assignees(task);
+
+    for (u32 assignee_index = 0; assignee_index < task->assignees.length; assignee_index++) {
+        User* user = entity_get(user_store.registry, task_assignees[assignee_index]);
 
         if (!user) {
             continue;
         }
 
-        bool is_not_last = assignee_index < task->num_assignees - 1;
+        bool is_not_last = assignee_index < task->assignees.length - 1;
         const char* name_pattern = "%.*s %.*s";
 
         if (is_not_last) {
@@ -453,8 +882,7 @@ bool draw_open_task_button(Table_Paint_Context& context, ImVec2 cell_top_left, f
 
 void draw_table_cell_for_task(Table_Paint_Context& context, u32 column, float column_width, Flattened_Folder_Task* flattened_task, ImVec2 cell_top_left) {
     ImVec2 padding(context.scale * 8.0f, context.text_padding_y);
-    Sorted_Folder_Task* sorted_task = flattened_task->sorted_task;
-    Folder_Task* task = sorted_task->source_task;
+    u32 task = flattened_task->task;
 
     switch (column) {
         case 0: {
@@ -463,8 +891,10 @@ void draw_table_cell_for_task(Table_Paint_Context& context, u32 column, float co
             if (flattened_task->num_visible_sub_tasks) {
                 ImVec2 arrow_point = cell_top_left + ImVec2(context.scale * 20.0f + nesting_level_padding, context.row_height / 2.0f);
 
-                if (draw_expand_arrow_button(context.draw_list, arrow_point, context.row_height, sorted_task->is_expanded)) {
-                    sorted_task->is_expanded = !sorted_task->is_expanded;
+                bool& is_expanded = task_columns.is_expanded[task];
+
+                if (draw_expand_arrow_button(context.draw_list, arrow_point, context.row_height, is_expanded)) {
+                    is_expanded = !is_expanded;
                     /* TODO We don't need to rebuild the whole tree there
                      * TODO     this is just inserting/removing subtask tree after the current task and could be done
                      * TODO     with a simple subtree traversal to determine subtree size, then a subsequent list insert
@@ -479,13 +909,15 @@ void draw_table_cell_for_task(Table_Paint_Context& context, u32 column, float co
 
             ImVec2 title_padding(context.scale * 40.0f + nesting_level_padding, context.text_padding_y);
 
-            char* start = task->title.start, * end = task->title.start + task->title.length;
+            String title = get_folder_task_summary(task)->title;
+
+            char* start = title.start, * end = title.start + title.length;
 
             context.draw_list->AddText(cell_top_left + title_padding, color_black_text_on_white, start, end);
 
             if (ImGui::IsMouseHoveringRect(cell_top_left, cell_top_left + ImVec2(column_width, context.row_height))) {
                 if (draw_open_task_button(context, cell_top_left, column_width)) {
-                    request_task_by_task_id(task->id);
+                    request_task_by_task_id(task_columns.ids[task]);
                 }
             }
 
@@ -493,7 +925,7 @@ void draw_table_cell_for_task(Table_Paint_Context& context, u32 column, float co
         }
 
         case 1: {
-            Custom_Status* status = sorted_task->cached_status;
+            Custom_Status* status = entity_get(custom_status_registry, task_columns.statuses[task]);
 
             if (status) {
                 char* start = status->name.start, * end = status->name.start + status->name.length;
@@ -507,14 +939,14 @@ void draw_table_cell_for_task(Table_Paint_Context& context, u32 column, float co
         case 2: {
             ImVec2 text_position = cell_top_left + padding;
 
-            draw_assignees_cell_contents(context.draw_list, task, text_position);
+            draw_assignees_cell_contents(context.draw_list, get_folder_task_summary(task), text_position);
 
             break;
         }
 
         default: {
             if (column > custom_columns_start_index) {
-                Custom_Field* custom_field = context.column_to_custom_field[column - custom_columns_start_index];
+                Entity_Index custom_field = current_folder.custom_columns[column - custom_columns_start_index];
                 Custom_Field_Value* field_value = try_find_custom_field_value_in_task(task, custom_field);
 
                 if (field_value) {
@@ -632,7 +1064,7 @@ void draw_table_header(Table_Paint_Context& context, ImVec2 window_top_left) {
                 Custom_Field* column_custom_field = context.column_to_custom_field[column - custom_columns_start_index];
 
                 if (button_state.pressed) {
-                    sort_by_custom_field(column_custom_field->id);
+                    sort_by_custom_field(column_custom_field);
                 }
 
                 sorting_by_this_column = sort_custom_field_id == column_custom_field->id;
@@ -679,8 +1111,20 @@ void draw_task_list() {
         if (!has_been_sorted_after_loading) {
             sort_by_field(Task_List_Sort_Field_Title);
             has_been_sorted_after_loading = true;
+            seen_task_store_version = task_store.registry.total_version;
         }
 
+        if (seen_task_store_version != task_store.registry.total_version) {
+            seen_task_store_version = task_store.registry.total_version;
+
+            if (have_sorted_tasks_changed()) {
+                update_task_columns();
+                sort_top_level_tasks_and_rebuild_flattened_tree();
+            }
+        }
+
+        finish_top_level_sort_if_done();
+
         const u32 grid_color = 0xffebebeb;
         const float scale = platform_get_pixel_ratio();
         const float row_height = 24.0f * scale;
@@ -722,18 +1166,20 @@ void draw_task_list() {
         for (u32 row = first_top_level_task_row; row < last_visible_row; row++) {
             Flattened_Folder_Task* flattened_task = &flattened_sorted_folder_task_tree[row];
 
-            bool is_expanded = flattened_task->sorted_task->is_expanded;
+            bool is_expanded = task_columns.is_expanded[flattened_task->task];
             bool needs_to_be_sorted = flattened_task->needs_sub_task_sort;
             bool has_more_than_one_visible_task = flattened_task->num_visible_sub_tasks > 1;
 
             if (is_expanded && needs_to_be_sorted && has_more_than_one_visible_task) {
-                sort_sub_tasks_of_task(flattened_task->sorted_task);
+                sort_sub_tasks_of_task(flattened_task->task);
                 rebuild_flattened_task_subtree(flattened_task);
 
                 flattened_task->needs_sub_task_sort = false;
             }
         }
 
+        u64 table_draw_start = platform_get_app_time_precise();
+
         for (u32 column = 0; column < paint_context.total_columns; column++) {
             float column_width = get_column_width(paint_context, column);
 
@@ -775,6 +1221,10 @@ void draw_task_list() {
         ImGui::Dummy(ImVec2(column_left_x, flattened_sorted_folder_task_tree.length * row_height));
         ImGui::EndChild();
 
+        last_table_draw_time_ms = platform_get_delta_time_ms(table_draw_start);
+        slowest_table_draw_time_ms = MAX(slowest_table_draw_time_ms, last_table_draw_time_ms);
+        last_table_draw_num_rows = last_visible_row - first_visible_row;
+
         if (queue_flattened_tree_rebuild) {
             queue_flattened_tree_rebuild = false;
             rebuild_flattened_task_tree();
@@ -807,18 +1257,20 @@ static void process_folder_contents_data_object(char* json, jsmntok_t*& token) {
 
     assert(object_token->type == JSMN_OBJECT);
 
-    Folder_Task* folder_task = &folder_tasks[folder_tasks.length];
-    folder_task->num_parent_task_ids = 0;
-    folder_task->num_parent_folder_ids = 0;
-    folder_task->num_custom_field_values = 0;
-    folder_task->num_assignees = 0;
+    u32 task_index = folder_tasks.length++;
+
+    Folder_Task* folder_task = &folder_tasks[task_index];
+    folder_task->parent_task_ids = {};
+    folder_task->parent_folder_ids = {};
 
-    Sorted_Folder_Task* sorted_folder_task = &sorted_folder_tasks[folder_tasks.length];
-    sorted_folder_task->num_sub_tasks = 0;
-    sorted_folder_task->source_task = folder_task;
-    sorted_folder_task->is_expanded = false;
+    task_columns.num_sub_tasks[task_index] = 0;
+    task_columns.is_expanded[task_index] = false;
 
-    folder_tasks.length++;
+    Task_Id id{};
+    String title{};
+    Custom_Status_Id custom_status_id{};
+    User_Id* task_assignees = NULL;
+    u32 num_assignees = 0;
 
     for (u32 propety_index = 0; propety_index < object_token->size; propety_index++, token++) {
         jsmntok_t* property_token = token++;
@@ -828,24 +1280,21 @@ static void process_folder_contents_data_object(char* json, jsmntok_t*& token) {
         jsmntok_t* next_token = token;
 
         if (json_string_equals(json, property_token, "title")) {
-            json_token_to_string(json, next_token, folder_task->title);
+            json_token_to_interned_string(json, next_token, title);
         } else if (json_string_equals(json, property_token, "id")) {
-            json_token_to_right_part_of_id16(json, next_token, folder_task->id);
+            json_token_to_right_part_of_id16(json, next_token, id);
         } else if (json_string_equals(json, property_token, "customStatusId")) {
-            json_token_to_right_part_of_id16(json, next_token, folder_task->custom_status_id);
-
-            folder_task->custom_status_id_hash = hash_id(folder_task->custom_status_id);
+            json_token_to_right_part_of_id16(json, next_token, custom_status_id);
         } else if (json_string_equals(json, property_token, "responsibleIds")) {
             assert(next_token->type == JSMN_ARRAY);
 
             token++;
 
-            if (next_token->size > 0) {
-                folder_task->assignees = lazy_array_reserve_n_values_relative_pointer(assignee_ids, next_token->size);
-            }
+            num_assignees = (u32) next_token->size;
+            task_assignees = (User_Id*) talloc(sizeof(User_Id) * num_assignees);
 
             for (u32 field_index = 0; field_index < next_token->size; field_index++, token++) {
-                json_token_to_id8(json, token, folder_task->assignees[folder_task->num_assignees++]);
+                json_token_to_id8(json, token, task_assignees[field_index]);
             }
 
             token--;
@@ -854,12 +1303,12 @@ static void process_folder_contents_data_object(char* json, jsmntok_t*& token) {
 
             token++;
 
-            if (next_token->size > 0) {
-                folder_task->parent_folder_ids = lazy_array_reserve_n_values_relative_pointer(parent_task_ids, next_token->size);
-            }
+            folder_task->parent_folder_ids = range_pool_reserve(parent_folder_ids, next_token->size);
+
+            Folder_Id* parents = range_pool_get(parent_folder_ids, folder_task->parent_folder_ids);
 
             for (u32 field_index = 0; field_index < next_token->size; field_index++, token++) {
-                json_token_to_right_part_of_id16(json, token, folder_task->parent_folder_ids[folder_task->num_parent_folder_ids++]);
+                json_token_to_right_part_of_id16(json, token, parents[field_index]);
             }
 
             token--;
@@ -868,12 +1317,12 @@ static void process_folder_contents_data_object(char* json, jsmntok_t*& token) {
 
             token++;
 
-            if (next_token->size > 0) {
-                folder_task->parent_task_ids = lazy_array_reserve_n_values_relative_pointer(parent_task_ids, next_token->size);
-            }
+            folder_task->parent_task_ids = range_pool_reserve(parent_task_ids, next_token->size);
+
+            Task_Id* parents = range_pool_get(parent_task_ids, folder_task->parent_task_ids);
 
             for (u32 field_index = 0; field_index < next_token->size; field_index++, token++) {
-                json_token_to_right_part_of_id16(json, token, folder_task->parent_task_ids[folder_task->num_parent_task_ids++]);
+                json_token_to_right_part_of_id16(json, token, parents[field_index]);
             }
 
             token--;
@@ -882,15 +1331,14 @@ static void process_folder_contents_data_object(char* json, jsmntok_t*& token) {
 
             token++;
 
-            if (next_token->size > 0) {
-                folder_task->custom_field_values = lazy_array_reserve_n_values_relative_pointer(custom_field_values, next_token->size);
-            }
-
             for (u32 field_index = 0; field_index < next_token->size; field_index++) {
-                Custom_Field_Value* value = &folder_task->custom_field_values[folder_task->num_custom_field_values++];
+                Custom_Field_Value value;
 
                 // TODO a dependency on task_view is not really good, should we move the code somewhere else?
-                process_task_custom_field_value(value, json, token);
+                process_task_custom_field_value(&value, json, token);
+
+                Custom_Field_Value* column = get_or_add_custom_field_column(entity_register(custom_field_registry, value.field_id));
+                column[task_index] = value;
             }
 
             token--;
@@ -900,10 +1348,46 @@ static void process_folder_contents_data_object(char* json, jsmntok_t*& token) {
         }
     }
 
-    sorted_folder_task->id = folder_task->id;
-    sorted_folder_task->id_hash = hash_id(folder_task->id);
+    task_columns.ids[task_index] = id;
+    task_columns.summaries[task_index] = update_task_summary(id, title, custom_status_id, task_assignees, num_assignees);
+
+    id_hash_map_put(&id_to_folder_task, task_index, id);
+}
+
+bool is_task_list_sort_running() {
+    return is_top_level_sort_running;
+}
+
+void keep_task_list_tasks() {
+    for (u32 task = 0; task < folder_tasks.length; task++) {
+        keep_task(task_columns.summaries[task]);
+    }
+}
+
+// Titles of tasks which came after the last update_task_columns aren't set yet, so they are taken from the summaries
+void keep_task_list_interned_strings() {
+    keep_interned_string(current_folder.name);
+
+    for (u32 task = 0; task < folder_tasks.length; task++) {
+        task_columns.titles[task] = get_folder_task_summary(task)->title;
+    }
+
+    for (u32 index = 0; index < custom_field_columns.length; index++) {
+        Custom_Field_Value* column = custom_field_columns[index];
 
-    id_hash_map_put(&id_to_sorted_folder_task, sorted_folder_task, folder_task->id, sorted_folder_task->id_hash);
+        if (!column) {
+            continue;
+        }
+
+        for (u32 task = 0; task < custom_field_column_length; task++) {
+            keep_interned_string(column[task].value);
+        }
+    }
+}
+
+void draw_task_list_debug_info() {
+    ImGui::Text("Task table: %i rows drawn in %.3fms, slowest %.3fms, last sort of %i tasks took %.3fms",
+                last_table_draw_num_rows, last_table_draw_time_ms, slowest_table_draw_time_ms, folder_tasks.length, last_sort_time_ms);
 }
 
 void process_folder_header_data(char* json, u32 data_size, jsmntok_t*& token) {
@@ -921,9 +1405,9 @@ void process_folder_header_data(char* json, u32 data_size, jsmntok_t*& token) {
         jsmntok_t* next_token = token;
 
         if (json_string_equals(json, property_token, "title")) {
-            json_token_to_string(json, next_token, current_folder.name);
+            json_token_to_interned_string(json, next_token, current_folder.name);
         } else if (json_string_equals(json, property_token, "customColumnIds")) {
-            current_folder.custom_columns = (Custom_Field_Id*) REALLOC(current_folder.custom_columns, sizeof(Custom_Field_Id) * next_token->size);
+            current_folder.custom_columns = (Entity_Index*) REALLOC(current_folder.custom_columns, sizeof(Entity_Index) * next_token->size);
             current_folder.num_custom_columns = 0;
 
             for (u32 array_index = 0; array_index < next_token->size; array_index++) {
@@ -931,7 +1415,10 @@ void process_folder_header_data(char* json, u32 data_size, jsmntok_t*& token) {
 
                 assert(id_token->type == JSMN_STRING);
 
-                json_token_to_right_part_of_id16(json, id_token, current_folder.custom_columns[current_folder.num_custom_columns++]);
+                Custom_Field_Id custom_field_id;
+                json_token_to_right_part_of_id16(json, id_token, custom_field_id);
+
+                current_folder.custom_columns[current_folder.num_custom_columns++] = entity_register(custom_field_registry, custom_field_id);
             }
         } else {
             eat_json(token);
@@ -945,94 +1432,95 @@ static void associate_parent_tasks_with_sub_tasks(Folder_Id top_parent_id) {
 
     // Step 0: determine and populate top level tasks
     for (u32 task_index = 0; task_index < folder_tasks.length; task_index++) {
-        Sorted_Folder_Task* folder_task = &sorted_folder_tasks[task_index];
-        Folder_Task* source_task = folder_task->source_task;
+        Folder_Task* source_task = &folder_tasks[task_index];
 
-        for (u32 id_index = 0; id_index < source_task->num_parent_folder_ids; id_index++) {
-            Folder_Id parent_id = source_task->parent_folder_ids[id_index];
+        Folder_Id* parents = range_pool_get(parent_folder_ids, source_task->parent_folder_ids);
+
+        for (u32 id_index = 0; id_index < source_task->parent_folder_ids.length; id_index++) {
+            Folder_Id parent_id = parents[id_index];
 
             if (parent_id == top_parent_id) {
-                Sorted_Folder_Task** pointer_to_task = lazy_array_reserve_n_values(top_level_tasks, 1);
-                *pointer_to_task = folder_task;
+                u32* top_level_task = lazy_array_reserve_n_values(top_level_tasks, 1);
+                *top_level_task = task_index;
             }
         }
     }
 
     // Step 1: count sub tasks for each parent, while also deciding which parents should go into the root
     for (u32 task_index = 0; task_index < folder_tasks.length; task_index++) {
-        Sorted_Folder_Task* folder_task = &sorted_folder_tasks[task_index];
-        Folder_Task* source_task = folder_task->source_task;
+        Folder_Task* source_task = &folder_tasks[task_index];
+
+        Task_Id* parents = range_pool_get(parent_task_ids, source_task->parent_task_ids);
 
-        for (u32 id_index = 0; id_index < source_task->num_parent_task_ids; id_index++) {
-            Task_Id parent_id = source_task->parent_task_ids[id_index];
-            Sorted_Folder_Task* parent_or_null = id_hash_map_get(&id_to_sorted_folder_task, parent_id, hash_id(parent_id));
+        for (u32 id_index = 0; id_index < source_task->parent_task_ids.length; id_index++) {
+            Task_Id parent_id = parents[id_index];
+            u32 parent_or_none = id_hash_map_get(&id_to_folder_task, parent_id);
 
-            if (parent_or_null) {
-                parent_or_null->num_sub_tasks++;
+            if (parent_or_none != NO_FOLDER_TASK) {
+                task_columns.num_sub_tasks[parent_or_none]++;
                 total_sub_tasks++;
             }
         }
     }
 
     // Step 2: allocate space for sub tasks
-    sub_tasks = (Sorted_Folder_Task**) REALLOC(sub_tasks, total_sub_tasks * sizeof(Sorted_Folder_Task*));
+    sub_tasks = (u32*) REALLOC(sub_tasks, total_sub_tasks * sizeof(u32));
     total_sub_tasks = 0;
 
     for (u32 task_index = 0; task_index < folder_tasks.length; task_index++) {
-        Sorted_Folder_Task* folder_task = &sorted_folder_tasks[task_index];
+        task_columns.sub_tasks_offsets[task_index] = total_sub_tasks;
 
-        if (folder_task->num_sub_tasks) {
-            folder_task->sub_tasks = sub_tasks + total_sub_tasks;
+        total_sub_tasks += task_columns.num_sub_tasks[task_index];
 
-            total_sub_tasks += folder_task->num_sub_tasks;
-
-            folder_task->num_sub_tasks = 0;
-        }
+        task_columns.num_sub_tasks[task_index] = 0;
     }
 
     // Step 3: fill sub tasks
     for (u32 task_index = 0; task_index < folder_tasks.length; task_index++) {
-        Sorted_Folder_Task* folder_task = &sorted_folder_tasks[task_index];
-        Folder_Task* source_task = folder_task->source_task;
+        Folder_Task* source_task = &folder_tasks[task_index];
 
-        for (u32 id_index = 0; id_index < source_task->num_parent_task_ids; id_index++) {
-            Task_Id parent_id = source_task->parent_task_ids[id_index];
+        Task_Id* parents = range_pool_get(parent_task_ids, source_task->parent_task_ids);
 
-            Sorted_Folder_Task* parent_or_null = id_hash_map_get(&id_to_sorted_folder_task, parent_id, hash_id(parent_id));
+        for (u32 id_index = 0; id_index < source_task->parent_task_ids.length; id_index++) {
+            Task_Id parent_id = parents[id_index];
 
-            if (parent_or_null) {
-                parent_or_null->sub_tasks[parent_or_null->num_sub_tasks++] = folder_task;
+            u32 parent_or_none = id_hash_map_get(&id_to_folder_task, parent_id);
+
+            if (parent_or_none != NO_FOLDER_TASK) {
+                sub_tasks[task_columns.sub_tasks_offsets[parent_or_none] + task_columns.num_sub_tasks[parent_or_none]++] = task_index;
             }
         }
     }
 }
 
 void process_folder_contents_data(char* json, u32 data_size, jsmntok_t*& token) {
-    if (id_to_sorted_folder_task.table) {
-        id_hash_map_destroy(&id_to_sorted_folder_task);
-    }
-
-    id_hash_map_init(&id_to_sorted_folder_task);
+    id_hash_map_clear(&id_to_folder_task);
+    id_hash_map_reserve(&id_to_folder_task, data_size);
 
     if (folder_tasks.length < data_size) {
         folder_tasks.data = (Folder_Task*) REALLOC(folder_tasks.data, sizeof(Folder_Task) * data_size);
-        sorted_folder_tasks = (Sorted_Folder_Task*) REALLOC(sorted_folder_tasks, sizeof(Sorted_Folder_Task) * data_size);
         flattened_sorted_folder_task_tree.data = (Flattened_Folder_Task*) REALLOC(flattened_sorted_folder_task_tree.data, sizeof(Flattened_Folder_Task) * data_size);
     }
 
+    reserve_task_columns(data_size);
+
     folder_tasks.length = 0;
 
-    lazy_array_soft_reset(custom_field_values);
-    lazy_array_soft_reset(parent_task_ids);
+    reset_custom_field_columns(data_size);
+    range_pool_reset(parent_folder_ids);
+    range_pool_reset(parent_task_ids);
     lazy_array_soft_reset(top_level_tasks);
 
     for (u32 array_index = 0; array_index < data_size; array_index++) {
+        temporary_storage_mark();
         process_folder_contents_data_object(json, token);
+        temporary_storage_reset();
     }
 
     associate_parent_tasks_with_sub_tasks(current_folder.id);
 
     has_been_sorted_after_loading = false;
+    folder_contents_version++;
 }
 
 void set_current_folder_id(Folder_Id id) {
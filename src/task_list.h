@@ -1,5 +1,15 @@
 void draw_task_list();
+void draw_task_list_debug_info();
 void set_current_folder_id(Folder_Id id);
 void process_current_folder_as_logical();
 void process_folder_contents_data(char* json, u32 data_size, jsmntok_t*& token);
-void process_folder_header_data(char* json, u32 data_size, jsmntok_t*& token);
\ No newline at end of file
+void process_folder_header_data(char* json, u32 data_size, jsmntok_t*& token);
+bool is_task_list_sort_running();
+
+void keep_task_list_tasks();
+
+// After keep_task_interned_strings, titles are copied from the task summaries
+void keep_task_list_interned_strings();
+
+// In temporary storage, NULL for columns whose field isn't loaded yet
+Custom_Field** map_columns_to_custom_fields();
\ No newline at end of file
@@ -6,9 +6,11 @@
 #include "render_rich_text.h"
 #include "platform.h"
 #include "users.h"
+#include "tasks.h"
 #include "workflows.h"
 #include "accounts.h"
 #include "ui.h"
+#include "tracing.h"
 
 #include <imgui.h>
 #include <cstdlib>
@@ -34,7 +36,7 @@ struct HSL {
 
 static Memory_Image checkmark{};
 static Array<User*> filtered_users{};
-static Lazy_Array<Rich_Text_String, 64> comment_strings{};
+static Block_Array<Rich_Text_String, 1024> comment_strings{};
 static Lazy_Array<char, 512> comment_chars{};
 
 static const float status_picker_row_height = 50.0f;
@@ -166,18 +168,20 @@ static void update_user_search(char* query) {
         query_lowercase[query_length] = 0;
     }
 
-    for (User* it = users.data; it != users.data + users.length; it++) {
+    for (User** it = users.data; it != users.data + users.length; it++) {
+        User* user = *it;
+
         if (add_all) {
-            filtered_users[filtered_users.length++] = it;
+            filtered_users[filtered_users.length++] = user;
 
             continue;
         }
 
-        char* first_name_contains_query = string_contains_substring_ignore_case(it->first_name, query_lowercase);
-        char* last_name_contains_query = string_contains_substring_ignore_case(it->last_name, query_lowercase);
+        char* first_name_contains_query = string_contains_substring_ignore_case(user->first_name, query_lowercase);
+        char* last_name_contains_query = string_contains_substring_ignore_case(user->last_name, query_lowercase);
 
         if (first_name_contains_query || last_name_contains_query) {
-            filtered_users[filtered_users.length++] = it;
+            filtered_users[filtered_users.length++] = user;
         }
     }
 
@@ -489,7 +493,7 @@ static void draw_folder_picker_contents(bool set_focus) {
         ImGuiListClipper clipper(all_nodes.length);
 
         while (clipper.Step()) {
-            for (Folder_Tree_Node* it = all_nodes.data + clipper.DisplayStart; it != all_nodes.data + clipper.DisplayEnd; it++) {
+            for (Folder_Tree_Node* it = all_nodes.values + clipper.DisplayStart; it != all_nodes.values + clipper.DisplayEnd; it++) {
                 ImGui::PushID(it);
 
                 if (draw_folder_picker_folder_selection_button(draw_list, it->name, it->color, selection_button_size, padding)) {
@@ -568,7 +572,7 @@ static void draw_parent_folders(Wrapping_Horizontal_Layout& layout, Array<Folder
         Folder_Tree_Node* folder_tree_node = find_folder_tree_node_by_id(folder_id);
 
         if (folder_tree_node) {
-            if (draw_parent_folder_ticker(layout, folder_tree_node, ghost_tags, folder_id != layout.has_drawn_at_least_one_element)) {
+            if (draw_parent_folder_ticker(layout, folder_tree_node, ghost_tags, layout.has_drawn_at_least_one_element)) {
                 select_and_request_folder_by_id(folder_tree_node->id);
             }
 
@@ -722,10 +726,12 @@ static void draw_add_assignee_button_and_contact_picker(Horizontal_Layout& layou
         float spacing = ImGui::GetStyle().FramePadding.x;
 
         if (strlen(search_buffer) == 0) {
-            for (User* it = suggested_users.data; it != suggested_users.data + suggested_users.length; it++) {
-                if (draw_contact_picker_assignee_selection_button(draw_list, it, {button_width, button_side_px}, spacing)) {
-                    add_item_to_array(current_task.assignees, it->id);
-                    add_assignee_to_task(current_task.id, it->id);
+            for (User** it = suggested_users.data; it != suggested_users.data + suggested_users.length; it++) {
+                User* user = *it;
+
+                if (draw_contact_picker_assignee_selection_button(draw_list, user, {button_width, button_side_px}, spacing)) {
+                    add_item_to_array(current_task.assignees, user->id);
+                    add_assignee_to_task(current_task.id, user->id);
 
                     ImGui::CloseCurrentPopup();
                 }
@@ -904,7 +910,7 @@ static bool draw_more_assignees_button(ImVec2 top_left, u32 how_many, float side
 }
 
 static void draw_assignees(Horizontal_Layout& layout, float wrap_pos) {
-    static User_Id assignee_to_remove_next_frame = 0;
+    static User_Id assignee_to_remove_next_frame{};
 
     const float avatar_side_px = assignee_avatar_side * platform_get_pixel_ratio();
     const int assignees_to_consider_for_name_plus_avatar_display = 2;
@@ -915,9 +921,9 @@ static void draw_assignees(Horizontal_Layout& layout, float wrap_pos) {
      * the rest are +X
      */
 
-    if (assignee_to_remove_next_frame) {
+    if (assignee_to_remove_next_frame.value) {
         remove_item_from_array_keep_order(current_task.assignees, assignee_to_remove_next_frame);
-        assignee_to_remove_next_frame = 0;
+        assignee_to_remove_next_frame = {};
 
         // Bail out early so behavior matched the case when there were no assignees in the first place
         if (!current_task.assignees.length) {
@@ -941,7 +947,7 @@ static void draw_assignees(Horizontal_Layout& layout, float wrap_pos) {
 
     for (u32 index = 0; index < current_task.assignees.length; index++) {
         User_Id user_id = current_task.assignees[index];
-        User* user = find_user_by_id(user_id, hash_id(user_id)); // TODO hash cache
+        User* user = find_user_by_id(user_id);
 
         if (!user) {
             continue;
@@ -1053,7 +1059,7 @@ static float draw_authors_and_task_id_and_return_new_wrap_width(Horizontal_Layou
     char* start = NULL, *end = NULL;
 
     tprintf("#%i by %.*s %.1s", &start, &end,
-            current_task.id,
+            current_task.id.value,
             author->first_name.length, author->first_name.start,
             author->last_name.start);
 
@@ -1558,7 +1564,7 @@ static void find_and_request_missing_folders_if_necessary() {
         u32 result = 0;
 
         for (Folder_Id* it = folders.data; it != folders.data + folders.length; it++) {
-            if (!find_folder_tree_node_by_id(*it, hash_id(*it))) {
+            if (!find_folder_tree_node_by_id(*it)) {
                 result++;
             }
         }
@@ -1570,7 +1576,7 @@ static void find_and_request_missing_folders_if_necessary() {
         for (Folder_Id* it = folders.data; it != folders.data + folders.length; it++) {
             Folder_Id folder_id = *it;
 
-            if (!find_folder_tree_node_by_id(folder_id, hash_id(folder_id))) {
+            if (!find_folder_tree_node_by_id(folder_id)) {
                 missing_folder_data.data[missing_folder_data.length++] = folder_id;
             }
         }
@@ -1588,13 +1594,11 @@ static void find_and_request_missing_folders_if_necessary() {
     }
 }
 
-typedef void (*Id_Processor)(char* json, jsmntok_t* token, s32& id);
-
 template <typename T>
 static void token_array_to_id_array(char* json,
                                     jsmntok_t*& token,
                                     Array<T>& id_array,
-                                    Id_Processor id_processor) {
+                                    void (*id_processor)(char* json, jsmntok_t* token, T& id)) {
     assert(token->type == JSMN_ARRAY);
 
     if (id_array.length < token->size) {
@@ -1612,11 +1616,111 @@ static void token_array_to_id_array(char* json,
     }
 }
 
+static bool string_to_number(String string, double& out_number) {
+    char* c = string.start;
+    char* end = string.start + string.length;
+
+    if (c == end) {
+        return false;
+    }
+
+    bool is_negative = *c == '-';
+
+    if (*c == '-' || *c == '+') {
+        c++;
+    }
+
+    double result = 0.0;
+    bool has_digits = false;
+
+    for (; c < end && isdigit((u8) *c); c++, has_digits = true) {
+        result = result * 10.0 + (*c - '0');
+    }
+
+    if (c < end && *c == '.') {
+        double scale = 0.1;
+
+        for (c++; c < end && isdigit((u8) *c); c++, has_digits = true, scale *= 0.1) {
+            result += (*c - '0') * scale;
+        }
+    }
+
+    if (c != end || !has_digits) {
+        return false;
+    }
+
+    out_number = is_negative ? -result : result;
+
+    return true;
+}
+
+static inline bool are_digits(char* start, u32 length) {
+    for (u32 index = 0; index < length; index++) {
+        if (!isdigit((u8) start[index])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Takes yyyy-mm-dd, with or without time after it
+static bool string_to_date(String string, s32& out_days_since_epoch) {
+    char* c = string.start;
+
+    if (string.length < 10 || (string.length > 10 && c[10] != 'T')) {
+        return false;
+    }
+
+    if (!are_digits(c, 4) || c[4] != '-' || !are_digits(c + 5, 2) || c[7] != '-' || !are_digits(c + 8, 2)) {
+        return false;
+    }
+
+    s32 year = (c[0] - '0') * 1000 + (c[1] - '0') * 100 + (c[2] - '0') * 10 + (c[3] - '0');
+    s32 month = (c[5] - '0') * 10 + (c[6] - '0');
+    s32 day = (c[8] - '0') * 10 + (c[9] - '0');
+
+    // Days from civil, shifted so years start in March and leap days come last
+    year -= month <= 2;
+
+    s32 era = year / 400;
+    s32 year_of_era = year - era * 400;
+    s32 day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    s32 day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+
+    out_days_since_epoch = era * 146097 + day_of_era - 719468;
+
+    return true;
+}
+
+// Values of every type come as strings, decoding them once saves sorting from doing that for every comparison
+static void decode_custom_field_value(Custom_Field_Value* custom_field_value) {
+    String& value = custom_field_value->value;
+
+    if (!value.length) {
+        custom_field_value->kind = Custom_Field_Value_Kind_None;
+    } else if (string_to_number(value, custom_field_value->number)) {
+        custom_field_value->kind = Custom_Field_Value_Kind_Number;
+    } else if (string_to_date(value, custom_field_value->date)) {
+        custom_field_value->kind = Custom_Field_Value_Kind_Date;
+    } else if (value.length == 4 && strncmp(value.start, "true", 4) == 0) {
+        custom_field_value->kind = Custom_Field_Value_Kind_Boolean;
+        custom_field_value->checked = true;
+    } else if (value.length == 5 && strncmp(value.start, "false", 5) == 0) {
+        custom_field_value->kind = Custom_Field_Value_Kind_Boolean;
+        custom_field_value->checked = false;
+    } else {
+        custom_field_value->kind = Custom_Field_Value_Kind_Text;
+    }
+}
+
 void process_task_custom_field_value(Custom_Field_Value* custom_field_value, char* json, jsmntok_t*& token) {
     jsmntok_t* object_token = token++;
 
     assert(object_token->type == JSMN_OBJECT);
 
+    *custom_field_value = {};
+
     for (u32 propety_index = 0; propety_index < object_token->size; propety_index++, token++) {
         jsmntok_t* property_token = token++;
 
@@ -1627,12 +1731,14 @@ void process_task_custom_field_value(Custom_Field_Value* custom_field_value, cha
         if (json_string_equals(json, property_token, "id")) {
             json_token_to_right_part_of_id16(json, next_token, custom_field_value->field_id);
         } else if (json_string_equals(json, property_token, "value")) {
-            json_token_to_string(json, next_token, custom_field_value->value);
+            json_token_to_interned_string(json, next_token, custom_field_value->value);
         } else {
             eat_json(token);
             token--;
         }
     }
+
+    decode_custom_field_value(custom_field_value);
 }
 
 void process_task_comments_data(char* json, u32 data_size, jsmntok_t*& token) {
@@ -1644,7 +1750,9 @@ void process_task_comments_data(char* json, u32 data_size, jsmntok_t*& token) {
 
     comments->length = 0;
 
-    lazy_array_soft_reset(comment_strings);
+    Memory_Tag previous_tag = set_memory_tag(Memory_Tag_Rich_Text);
+
+    block_array_soft_reset(comment_strings);
     lazy_array_soft_reset(comment_chars);
 
     for (u32 array_index = 0; array_index < data_size; array_index++) {
@@ -1669,13 +1777,14 @@ void process_task_comments_data(char* json, u32 data_size, jsmntok_t*& token) {
                 temporary_storage_mark();
 
                 Rich_Text temporary_text = parse_string_into_temporary_rich_text(comment_text);
-                Rich_Text_String* persisted_strings = lazy_array_reserve_n_values(comment_strings, temporary_text.rich.length);
+                Rich_Text_String* persisted_strings = block_array_reserve_n_values(comment_strings, temporary_text.rich.length);
                 char* persisted_chars = lazy_array_reserve_n_values(comment_chars, temporary_text.raw.length);
 
-                // We'll fix up the data pointers later
+                // Strings don't move, but we'll fix up the chars pointer later
                 memcpy(persisted_chars, temporary_text.raw.start, temporary_text.raw.length);
                 memcpy(persisted_strings, temporary_text.rich.data, temporary_text.rich.length * sizeof(Rich_Text_String));
 
+                comment->text.rich.data = persisted_strings;
                 comment->text.rich.length = temporary_text.rich.length;
                 comment->text.raw.length = temporary_text.raw.length;
 
@@ -1690,24 +1799,25 @@ void process_task_comments_data(char* json, u32 data_size, jsmntok_t*& token) {
     }
 
     // Data pointer fix-up
-    Rich_Text_String* current_string = comment_strings.data;
     char* current_char = comment_chars.data;
 
     for (Task_Comment* it = comments->data; it != comments->data + comments->length; it++) {
         Rich_Text& text = it->text;
 
         text.raw.start = current_char;
-        text.rich.data = current_string;
 
         current_char += text.raw.length;
-        current_string += text.rich.length;
     }
+
+    set_memory_tag(previous_tag);
 }
 
 void parse_and_update_task_description(String description) {
     Rich_Text temporary_text = parse_string_into_temporary_rich_text(description);
     Rich_Text& persistent_text = current_task.description;
 
+    Memory_Tag previous_tag = set_memory_tag(Memory_Tag_Rich_Text);
+
     persistent_text.raw.start = (char*) REALLOC(persistent_text.raw.start, temporary_text.raw.length);
     persistent_text.raw.length = temporary_text.raw.length;
 
@@ -1719,6 +1829,8 @@ void parse_and_update_task_description(String description) {
     persistent_text.rich.length = temporary_text.rich.length;
 
     memcpy(persistent_text.rich.data, temporary_text.rich.data, rich_memory);
+
+    set_memory_tag(previous_tag);
 }
 
 void process_task_data(char* json, u32 data_size, jsmntok_t*& token) {
@@ -1745,28 +1857,29 @@ void process_task_data(char* json, u32 data_size, jsmntok_t*& token) {
         jsmntok_t* next_token = token;
 
 #define IS_PROPERTY(s) json_string_equals(json, property_token, (s))
-#define TOKEN_TO_STRING(s) json_token_to_string(json, next_token, (s))
+#define TOKEN_TO_STRING(s) json_token_to_interned_string(json, next_token, (s))
 
         if (IS_PROPERTY("id")) {
             json_token_to_right_part_of_id16(json, next_token, current_task.id);
         } else if (IS_PROPERTY("title")) {
             TOKEN_TO_STRING(current_task.title);
         } else if (IS_PROPERTY("description")) {
-            TOKEN_TO_STRING(description);
+            // Copied by parse_and_update_task_description, no need to keep it around
+            json_token_to_string(json, next_token, description);
         } else if (IS_PROPERTY("permalink")) {
             TOKEN_TO_STRING(current_task.permalink);
         } else if (IS_PROPERTY("customStatusId")) {
             json_token_to_right_part_of_id16(json, next_token, current_task.status_id);
         } else if (IS_PROPERTY("responsibleIds")) {
-            token_array_to_id_array(json, token, current_task.assignees, json_token_to_id8);
+            token_array_to_id_array(json, token, current_task.assignees, json_token_to_id8<User>);
         } else if (IS_PROPERTY("authorIds")) {
-            token_array_to_id_array(json, token, current_task.authors, json_token_to_id8);
+            token_array_to_id_array(json, token, current_task.authors, json_token_to_id8<User>);
         } else if (IS_PROPERTY("parentIds")) {
-            token_array_to_id_array(json, token, current_task.parents, json_token_to_right_part_of_id16);
+            token_array_to_id_array(json, token, current_task.parents, json_token_to_right_part_of_id16<Folder>);
         } else if (IS_PROPERTY("inheritedCustomColumnIds")) {
-            token_array_to_id_array(json, token, current_task.inherited_custom_fields, json_token_to_right_part_of_id16);
+            token_array_to_id_array(json, token, current_task.inherited_custom_fields, json_token_to_right_part_of_id16<Custom_Field>);
         } else if (IS_PROPERTY("superParentIds")) {
-            token_array_to_id_array(json, token, current_task.super_parents, json_token_to_right_part_of_id16);
+            token_array_to_id_array(json, token, current_task.super_parents, json_token_to_right_part_of_id16<Folder>);
         } else if (IS_PROPERTY("customFields")) {
             assert(next_token->type == JSMN_ARRAY);
 
@@ -1797,6 +1910,9 @@ void process_task_data(char* json, u32 data_size, jsmntok_t*& token) {
 #undef IS_PROPERTY
 #undef TOKEN_TO_STRING
 
+    // Both task_request and modify_task_request end up here, the task list and the inbox pick the changes up from the store
+    update_task_summary(current_task.id, current_task.title, current_task.status_id, current_task.assignees.data, current_task.assignees.length);
+
     parse_and_update_task_description(description);
     find_and_request_missing_folders_if_necessary();
 }
\ No newline at end of file
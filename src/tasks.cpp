@@ -0,0 +1,146 @@
+#include "tasks.h"
+#include "users.h"
+#include "workflows.h"
+#include "interned_strings.h"
+
+Entity_Store<Task_Summary, Task> task_store{};
+
+// Never reset, a task gets a new range only when its assignees outgrow the old one and gives the old one back
+static Range_Pool<Entity_Index> task_assignees{};
+
+// By entity index, only used during a sweep
+static bool* is_task_kept = NULL;
+static u32 is_task_kept_length = 0;
+static u32 swept_length = 0;
+
+static bool update_task_assignees(Task_Summary* task, User_Id* assignees, u32 num_assignees) {
+    Entity_Index* current = get_task_assignees(task);
+
+    bool changed = task->assignees.length != num_assignees;
+
+    for (u32 index = 0; index < num_assignees && !changed; index++) {
+        changed = current[index] != entity_register(user_store.registry, assignees[index]);
+    }
+
+    if (!changed) {
+        return false;
+    }
+
+    if (num_assignees > task->assignees_capacity) {
+        Range_Handle<Entity_Index> old_range = task->assignees;
+        old_range.length = task->assignees_capacity;
+
+        range_pool_release(task_assignees, old_range);
+
+        task->assignees = range_pool_reserve(task_assignees, num_assignees);
+        task->assignees_capacity = num_assignees;
+    }
+
+    task->assignees.length = num_assignees;
+
+    Entity_Index* target = get_task_assignees(task);
+
+    for (u32 index = 0; index < num_assignees; index++) {
+        target[index] = entity_register(user_store.registry, assignees[index]);
+    }
+
+    return true;
+}
+
+Entity_Index update_task_summary(Task_Id id, String title, Custom_Status_Id status, User_Id* assignees, u32 num_assignees) {
+    Entity_Index index;
+    bool is_new;
+
+    Task_Summary* task = entity_store_get_or_add(task_store, id, index, is_new);
+    task->id = id;
+
+    // Tasks without a status would otherwise register a bogus entity for the zero id
+    Entity_Index status_index = status.value ? entity_register(custom_status_registry, status) : NO_ENTITY;
+
+    // Titles are interned, same contents means same pointer
+    bool changed = task->title.start != title.start || task->status != status_index;
+
+    task->title = title;
+    task->status = status_index;
+
+    changed |= update_task_assignees(task, assignees, num_assignees);
+
+    if (changed && !is_new) {
+        entity_touch(task_store.registry, index);
+    }
+
+    return index;
+}
+
+Entity_Index update_task_title(Task_Id id, String title) {
+    Entity_Index index;
+    bool is_new;
+
+    Task_Summary* task = entity_store_get_or_add(task_store, id, index, is_new);
+    task->id = id;
+
+    if (task->title.start != title.start) {
+        task->title = title;
+
+        if (!is_new) {
+            entity_touch(task_store.registry, index);
+        }
+    }
+
+    return index;
+}
+
+Entity_Index* get_task_assignees(Task_Summary* task) {
+    // Capacity is there for in place updates, but the range could have been handed out with length 0
+    Range_Handle<Entity_Index> range = task->assignees;
+    range.length = task->assignees_capacity;
+
+    return range_pool_get(task_assignees, range);
+}
+
+void begin_task_sweep() {
+    u32 length = task_store.registry.length;
+
+    if (is_task_kept_length < length) {
+        is_task_kept = (bool*) REALLOC(is_task_kept, sizeof(bool) * length);
+        is_task_kept_length = length;
+    }
+
+    memset(is_task_kept, 0, sizeof(bool) * length);
+
+    swept_length = task_store.registry.length;
+}
+
+void keep_task(Entity_Index index) {
+    if (index != NO_ENTITY && index < swept_length) {
+        is_task_kept[index] = true;
+    }
+}
+
+u32 end_task_sweep() {
+    u32 num_removed = 0;
+
+    for (Entity_Index index = 1; index < swept_length; index++) {
+        Task_Summary* task = get_task_summary(index);
+
+        if (!task || is_task_kept[index]) {
+            continue;
+        }
+
+        Range_Handle<Entity_Index> range = task->assignees;
+        range.length = task->assignees_capacity;
+
+        range_pool_release(task_assignees, range);
+        entity_store_remove(task_store, task->id, index);
+
+        num_removed++;
+    }
+
+    return num_removed;
+}
+
+void keep_task_interned_strings() {
+    for (u32 index = 0; index < task_store.values.length; index++) {
+        keep_interned_string(task_store.values[index].title);
+    }
+}
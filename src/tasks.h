@@ -0,0 +1,40 @@
+#pragma once
+
+#include "common.h"
+#include "entity_registry.h"
+#include "handle_pool.h"
+
+/**
+ * What every view shows of a task: the task list, the task view and the inbox all write into
+ *  the same Task_Summary, whichever response the task came with. A task changed through
+ *  modify_task_request is then up to date in the task list without refetching the folder.
+ *
+ * The task entity is only touched when something actually changed, so reloading the same
+ *  folder doesn't make views rebuild anything.
+ *
+ * Tasks no view shows anymore are dropped by a sweep: every view passes the task indices it holds
+ *  to keep_task between begin_task_sweep and end_task_sweep, the rest is removed from task_store.
+ */
+struct Task_Summary {
+    Task_Id id;
+    String title;
+    Entity_Index status; // In custom_status_registry
+    Range_Handle<Entity_Index> assignees; // In user_store
+    u32 assignees_capacity;
+};
+
+extern Entity_Store<Task_Summary, Task> task_store;
+
+Entity_Index update_task_summary(Task_Id id, String title, Custom_Status_Id status, User_Id* assignees, u32 num_assignees);
+Entity_Index update_task_title(Task_Id id, String title);
+
+Entity_Index* get_task_assignees(Task_Summary* task);
+void keep_task_interned_strings();
+
+void begin_task_sweep();
+void keep_task(Entity_Index index);
+u32 end_task_sweep(); // Returns how many tasks were removed
+
+inline Task_Summary* get_task_summary(Entity_Index index) {
+    return entity_get(task_store.registry, index);
+}
@@ -4,61 +4,164 @@
 #include <cstdio>
 #include "temporary_storage.h"
 #include "common.h"
+#include "tracing.h"
+
+/**
+ * Chain of blocks, allocations are bumped from the current one and move on to the next block when it's full.
+ * Blocks are never freed, clearing or resetting just moves back to an earlier block, so after a couple of
+ *  frames the chain is big enough for the worst frame and we stop touching the heap altogether.
+ */
+struct Temporary_Storage_Block {
+    Temporary_Storage_Block* next;
+    u32 size;
+};
+
+static const u32 default_block_size = 1024 * 1024 * 4;
+static const u32 alignment = 8;
+
+/**
+ * Every thread gets its own chain, so worker threads can talloc and mark/reset without any locking.
+ * Threads other than the main one get their first block on the first talloc.
+ */
+struct Temporary_Storage {
+    Temporary_Storage_Block* first_block = NULL;
+    Temporary_Storage_Block* current_block = NULL;
+
+    char* pointer_current = nullptr;
+    char* pointer_end = nullptr;
+    char* pointer_previous = nullptr;
+
+    // Bytes used in blocks before the current one, so the total doesn't need a walk over the chain
+    u32 bytes_used_in_previous_blocks = 0;
+
+    Temporary_Storage_Block* mark_block = NULL;
+    char* mark_pointer = nullptr;
+    u32 mark_bytes_used_in_previous_blocks = 0;
+
+    u32 num_blocks = 0;
+    u32 reserved_bytes = 0;
+    u32 frame_high_water = 0;
+    u32 last_frame_high_water = 0;
+    u32 all_time_high_water = 0;
+};
+
+static thread_local Temporary_Storage storage;
+
+static inline char* block_data(Temporary_Storage_Block* block) {
+    return (char*) (block + 1);
+}
+
+static Temporary_Storage_Block* allocate_block(u32 size) {
+    Memory_Tag previous_tag = set_memory_tag(Memory_Tag_Temporary_Storage);
+
+    Temporary_Storage_Block* block = (Temporary_Storage_Block*) MALLOC(sizeof(Temporary_Storage_Block) + size);
 
-static char* pointer_initial = nullptr;
-static char* pointer_current = nullptr;
-static char* pointer_previous = nullptr;
-static char* pointer_mark = nullptr;
+    set_memory_tag(previous_tag);
 
-static const u32 available_memory_bytes = 1024 * 1024 * 16;
+    block->next = NULL;
+    block->size = size;
 
-static void** temporary_heap_pointers = NULL;
-static u32 num_temporary_heap_pointers = 0;
+    storage.num_blocks++;
+    storage.reserved_bytes += size;
+
+    return block;
+}
+
+static void make_block_current(Temporary_Storage_Block* block) {
+    storage.current_block = block;
+    storage.pointer_current = block_data(block);
+    storage.pointer_end = storage.pointer_current + block->size;
+    storage.pointer_previous = nullptr;
+}
 
 void init_temporary_storage() {
-    pointer_initial = static_cast<char*>(MALLOC(available_memory_bytes));
-    pointer_current = pointer_initial;
+    storage.first_block = allocate_block(default_block_size);
+
+    make_block_current(storage.first_block);
 }
 
-void clear_temporary_storage() {
-    pointer_current = pointer_initial;
+// Frees the calling thread's whole chain, workers call it when they run out of jobs
+void release_temporary_storage() {
+    Temporary_Storage_Block* block = storage.first_block;
 
-    void** head = temporary_heap_pointers;
+    while (block) {
+        Temporary_Storage_Block* next = block->next;
 
-    for (void** end = head + num_temporary_heap_pointers; head < end; head++) {
-        printf("Freeing temporary allocated %p\n", *head);
+        FREE(block);
 
-        FREE(*head);
+        block = next;
     }
 
-    temporary_heap_pointers = NULL;
-    num_temporary_heap_pointers = 0;
+    storage = {};
+}
+
+void clear_temporary_storage() {
+    if (!storage.first_block) {
+        return;
+    }
+
+    storage.last_frame_high_water = storage.frame_high_water;
+    storage.frame_high_water = 0;
+
+    storage.bytes_used_in_previous_blocks = 0;
+
+    make_block_current(storage.first_block);
 }
 
 void temporary_storage_mark() {
-    pointer_mark = pointer_current;
+    if (!storage.first_block) {
+        init_temporary_storage();
+    }
+
+    storage.mark_block = storage.current_block;
+    storage.mark_pointer = storage.pointer_current;
+    storage.mark_bytes_used_in_previous_blocks = storage.bytes_used_in_previous_blocks;
 }
 
 void temporary_storage_reset() {
-    pointer_current = pointer_mark;
+    make_block_current(storage.mark_block);
+
+    storage.pointer_current = storage.mark_pointer;
+    storage.bytes_used_in_previous_blocks = storage.mark_bytes_used_in_previous_blocks;
+}
+
+// Reuses the next block in the chain if it's big enough, otherwise puts a new one in front of it
+static void advance_to_block_with_space_for(u32 size) {
+    storage.bytes_used_in_previous_blocks += (u32) (storage.pointer_current - block_data(storage.current_block));
+
+    Temporary_Storage_Block* next = storage.current_block->next;
+
+    if (!next || next->size < size) {
+        Temporary_Storage_Block* new_block = allocate_block(MAX(default_block_size, size));
+        new_block->next = next;
+        storage.current_block->next = new_block;
+
+        next = new_block;
+    }
+
+    make_block_current(next);
 }
 
 void* talloc(u32 size) {
-    if ((pointer_current - pointer_initial) + size > available_memory_bytes) {
-        void* heap_pointer = MALLOC(size);
+    if (!storage.first_block) {
+        init_temporary_storage();
+    }
 
-        printf("Requested allocation of %i bytes which exceeded %i size of temporary storage, %p was allocated on heap\n",
-               size, available_memory_bytes, heap_pointer);
+    size = (size + alignment - 1) & ~(alignment - 1);
 
-        return heap_pointer;
+    if (storage.pointer_current + size > storage.pointer_end) {
+        advance_to_block_with_space_for(size);
     }
 
-    size = (size + 4) & ~0x03; // Align, &~0x03 simply sets two trailing bits to 0
+    storage.pointer_previous = storage.pointer_current;
+    storage.pointer_current += size;
+
+    u32 bytes_used = storage.bytes_used_in_previous_blocks + (u32) (storage.pointer_current - block_data(storage.current_block));
 
-    pointer_previous = pointer_current;
-    pointer_current += size;
+    storage.frame_high_water = MAX(storage.frame_high_water, bytes_used);
+    storage.all_time_high_water = MAX(storage.all_time_high_water, bytes_used);
 
-    return pointer_previous;
+    return storage.pointer_previous;
 }
 
 void* trealloc(void* pointer, u32 previous_size, u32 new_size) {
@@ -66,11 +169,21 @@ void* trealloc(void* pointer, u32 previous_size, u32 new_size) {
         return talloc(new_size);
     }
 
-    if (pointer == pointer_previous) {
-        pointer_current = pointer_previous;
-    } else {
-        memcpy(pointer_current, pointer, previous_size);
+    // Most recent allocation can just grow in place if the block has room for it
+    if (pointer == storage.pointer_previous && storage.pointer_previous + new_size <= storage.pointer_end) {
+        storage.pointer_current = storage.pointer_previous;
+
+        return talloc(new_size);
     }
 
-    return talloc(new_size);
+    void* new_pointer = talloc(new_size);
+
+    memcpy(new_pointer, pointer, MIN(previous_size, new_size));
+
+    return new_pointer;
+}
+
+void draw_temporary_storage_debug_info() {
+    ImGui::Text("Temporary storage: %.2fkb last frame, %.2fkb all time high, %i blocks with %.2fkb reserved",
+                storage.last_frame_high_water / 1024.0f, storage.all_time_high_water / 1024.0f, storage.num_blocks, storage.reserved_bytes / 1024.0f);
 }
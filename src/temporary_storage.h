@@ -1,9 +1,13 @@
 #include <cstddef>
 #include "common.h"
 
+// All of those work on the calling thread's own storage, main thread's is cleared every frame and workers' after every job
 void init_temporary_storage();
+void release_temporary_storage();
 void clear_temporary_storage();
 void temporary_storage_mark();
 void temporary_storage_reset();
 void* talloc(u32 size);
-void* trealloc(void* pointer, u32 previous_size, u32 new_size);
\ No newline at end of file
+void* trealloc(void* pointer, u32 previous_size, u32 new_size);
+
+void draw_temporary_storage_debug_info();
\ No newline at end of file
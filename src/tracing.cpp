@@ -1,21 +1,380 @@
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
+#include <atomic>
 #include "common.h"
+#include "platform.h"
+#include "tracing.h"
+
+#if MEMORY_TRACING == MEMORY_TRACING_SAMPLED && !EMSCRIPTEN
+#include <execinfo.h>
+#endif
+
+const char* memory_tracing_mode_name() {
+#if MEMORY_TRACING == MEMORY_TRACING_RAW
+    return "raw";
+#elif MEMORY_TRACING == MEMORY_TRACING_SAMPLED
+    return "sampled";
+#else
+    return "full";
+#endif
+}
+
+static thread_local Memory_Tag current_memory_tag = Memory_Tag_Other;
+
+// Counted even for allocations which are not sampled, this is how we check that frames don't touch the heap
+static thread_local u32 heap_allocation_count = 0;
+
+u32 take_heap_allocation_count() {
+    u32 result = heap_allocation_count;
+
+    heap_allocation_count = 0;
+
+    return result;
+}
+
+Memory_Tag set_memory_tag(Memory_Tag tag) {
+    Memory_Tag previous_tag = current_memory_tag;
+
+    current_memory_tag = tag;
+
+    return previous_tag;
+}
+
+void* imgui_malloc_wrapper(size_t size, void* user_data) {
+    (void) user_data;
+
+    Memory_Tag previous_tag = set_memory_tag(Memory_Tag_ImGui);
+    void* result = MALLOC(size);
+    set_memory_tag(previous_tag);
+
+    return result;
+}
+
+void imgui_free_wrapper(void* ptr, void* user_data) {
+    (void) user_data;
+
+    // ImGui frees NULL all the time
+    if (ptr) {
+        FREE(ptr);
+    }
+}
+
+#if MEMORY_TRACING == MEMORY_TRACING_RAW
+
+void draw_memory_records() {
+    ImGui::Text("Memory tracing is disabled in this build, configure with -DMEMORY_TRACING=FULL or SAMPLED");
+}
+
+void write_memory_metrics_if_necessary() {}
+
+#else
+
+static const u32 max_callsite_stack_frames = 16;
 
 struct Memory_Record {
     void* pointer;
     size_t size;
-    u32 line;
-    const char* function;
+    u32 callsite;
+    Memory_Tag tag;
+};
+
+struct Memory_Tag_Stats {
+    u64 live_bytes;
+    u64 peak_bytes;
+    u32 live_blocks;
+};
+
+struct Allocation_Callsite {
     const char* file;
+    const char* function;
+    u32 line;
+
+    // Only captured in sampled mode, same line reached through different stacks is a different callsite then
+    u32 stack_hash;
+    u32 num_stack_frames;
+    void* stack_frames[max_callsite_stack_frames];
+
+    u64 live_bytes;
+    u64 peak_bytes;
+    u32 live_blocks;
+    u32 total_allocations;
+};
+
+enum Callsite_Sort_Type {
+    Callsite_Sort_Type_Location,
+    Callsite_Sort_Type_Live_Bytes,
+    Callsite_Sort_Type_Live_Blocks,
+    Callsite_Sort_Type_Total_Allocations,
+    Callsite_Sort_Type_Peak_Bytes
 };
 
 static u32 history_length = 0;
 static u32 history_watermark = 0;
 static Memory_Record* memory_records = NULL;
 
-static u32 total_allocated_memory = 0;
+/**
+ * Open addressing index into memory_records by pointer, linear probing with backward shift deletion.
+ * Slots hold record index + 1, 0 means the slot is empty. Size is a power of two, kept at most half full.
+ */
+static u32* pointer_index = NULL;
+static u32 pointer_index_size = 0;
+
+// Same scheme as the pointer index, keyed by file + function + line pointers
+static Allocation_Callsite* callsites = NULL;
+static u32 num_callsites = 0;
+static u32 callsites_watermark = 0;
+static u32* callsite_index = NULL;
+static u32 callsite_index_size = 0;
+
+// Callsites are copied out under the lock every frame, so drawing them doesn't block other threads
+static Allocation_Callsite* callsites_snapshot = NULL;
+static u32 callsites_snapshot_watermark = 0;
+
+static Callsite_Sort_Type callsite_sort_type = Callsite_Sort_Type_Live_Bytes;
+static bool callsite_sort_descending = true;
+
+static const char* collapsed_stacks_file_path = "allocations.folded";
+
+static const char* memory_tag_names[] = {
+        "Other",
+        "JSON",
+        "JSON tokens",
+        "Task model",
+        "Folder tree",
+        "Users",
+        "Rich text",
+        "Images",
+        "ImGui",
+        "Temporary storage"
+};
+
+static_assert(ARRAY_SIZE(memory_tag_names) == Memory_Tag_Count, "Every memory tag needs a name");
+
+static Memory_Tag_Stats memory_tag_stats[Memory_Tag_Count]{};
+
+static const char* memory_metrics_file_path = "memory_metrics.csv";
+static const float memory_metrics_interval_ms = 10000.0f;
+static u64 memory_metrics_started_at = 0;
+static u64 memory_metrics_written_at = 0;
+static bool memory_metrics_header_written = false;
+
+static u64 total_allocated_memory = 0;
+
+#if MEMORY_TRACING == MEMORY_TRACING_SAMPLED
+static std::atomic<u32> allocation_counter{0};
+
+static inline bool should_sample_allocation() {
+    return allocation_counter.fetch_add(1, std::memory_order_relaxed) % MEMORY_TRACING_SAMPLE_RATE == 0;
+}
+
+static u32 capture_stack(void** frames) {
+#if EMSCRIPTEN
+    return 0;
+#else
+    return (u32) backtrace(frames, max_callsite_stack_frames);
+#endif
+}
+#endif
+
+// Networking threads allocate too. Critical sections are tiny, so a spinlock it is
+static std::atomic_flag memory_records_lock = ATOMIC_FLAG_INIT;
+
+static inline void lock_memory_records() {
+    while (memory_records_lock.test_and_set(std::memory_order_acquire));
+}
+
+static inline void unlock_memory_records() {
+    memory_records_lock.clear(std::memory_order_release);
+}
+
+static inline u32 hash_pointer(void* pointer) {
+    u64 value = (u64) (uintptr_t) pointer;
+
+    // Allocations are at least 16 byte aligned, low bits carry nothing
+    return (u32) (((value >> 4) * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+static u32 find_pointer_slot(void* pointer) {
+    u32 mask = pointer_index_size - 1;
+
+    for (u32 slot = hash_pointer(pointer) & mask;; slot = (slot + 1) & mask) {
+        u32 record_index_plus_one = pointer_index[slot];
+
+        if (!record_index_plus_one || memory_records[record_index_plus_one - 1].pointer == pointer) {
+            return slot;
+        }
+    }
+}
+
+static void grow_pointer_index() {
+    u32* old_index = pointer_index;
+    u32 old_size = pointer_index_size;
+
+    pointer_index_size = old_size ? old_size * 2 : 4096;
+    pointer_index = (u32*) calloc(pointer_index_size, sizeof(u32));
+
+    for (u32 slot = 0; slot < old_size; slot++) {
+        u32 record_index_plus_one = old_index[slot];
+
+        if (record_index_plus_one) {
+            pointer_index[find_pointer_slot(memory_records[record_index_plus_one - 1].pointer)] = record_index_plus_one;
+        }
+    }
+
+    free(old_index);
+}
+
+static void remove_pointer_slot(u32 slot) {
+    u32 mask = pointer_index_size - 1;
+    u32 empty_slot = slot;
+
+    pointer_index[empty_slot] = 0;
+
+    // Shift back everything in the probe chain which would otherwise become unreachable
+    for (u32 current = (slot + 1) & mask; pointer_index[current]; current = (current + 1) & mask) {
+        u32 record_index_plus_one = pointer_index[current];
+        u32 desired_slot = hash_pointer(memory_records[record_index_plus_one - 1].pointer) & mask;
+
+        // Distance from the desired slot to where it is, compared to distance to the hole
+        if (((current - desired_slot) & mask) >= ((current - empty_slot) & mask)) {
+            pointer_index[empty_slot] = record_index_plus_one;
+            pointer_index[current] = 0;
+            empty_slot = current;
+        }
+    }
+}
+
+// Returns NULL for pointers we never saw, record stays valid until the next record/remove
+static Memory_Record* find_record(void* pointer, u32& out_slot) {
+    if (!pointer_index_size) {
+        return NULL;
+    }
+
+    out_slot = find_pointer_slot(pointer);
+
+    u32 record_index_plus_one = pointer_index[out_slot];
+
+    return record_index_plus_one ? &memory_records[record_index_plus_one - 1] : NULL;
+}
+
+static void remove_record(u32 slot) {
+    u32 record_index = pointer_index[slot] - 1;
+
+    remove_pointer_slot(slot);
+
+    history_length--;
+
+    // Move the last record into the hole and repoint its slot
+    if (record_index != history_length) {
+        Memory_Record& last_record = memory_records[history_length];
+
+        pointer_index[find_pointer_slot(last_record.pointer)] = record_index + 1;
+        memory_records[record_index] = last_record;
+    }
+}
+
+static inline u32 hash_callsite(const char* file, const char* function, u32 line, u32 stack_hash) {
+    u64 value = (u64) (uintptr_t) file ^ ((u64) (uintptr_t) function << 1) ^ line ^ ((u64) stack_hash << 32);
+
+    return (u32) ((value * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+static u32 find_callsite_slot(const char* file, const char* function, u32 line, u32 stack_hash) {
+    u32 mask = callsite_index_size - 1;
+
+    for (u32 slot = hash_callsite(file, function, line, stack_hash) & mask;; slot = (slot + 1) & mask) {
+        u32 callsite_plus_one = callsite_index[slot];
+
+        if (!callsite_plus_one) {
+            return slot;
+        }
+
+        Allocation_Callsite& callsite = callsites[callsite_plus_one - 1];
+
+        if (callsite.line == line && callsite.stack_hash == stack_hash && callsite.file == file && callsite.function == function) {
+            return slot;
+        }
+    }
+}
+
+static void grow_callsite_index() {
+    free(callsite_index);
+
+    callsite_index_size = callsite_index_size ? callsite_index_size * 2 : 1024;
+    callsite_index = (u32*) calloc(callsite_index_size, sizeof(u32));
+
+    for (u32 index = 0; index < num_callsites; index++) {
+        Allocation_Callsite& callsite = callsites[index];
+
+        callsite_index[find_callsite_slot(callsite.file, callsite.function, callsite.line, callsite.stack_hash)] = index + 1;
+    }
+}
+
+// Callsites are never removed, there is only so many places in the code which allocate
+static u32 find_or_add_callsite(const char* file, const char* function, u32 line, void** stack_frames = NULL, u32 num_stack_frames = 0) {
+    if ((num_callsites + 1) * 2 > callsite_index_size) {
+        grow_callsite_index();
+    }
+
+    u32 stack_hash = num_stack_frames ? XXH32(stack_frames, num_stack_frames * sizeof(void*), hash_seed) : 0;
+    u32 slot = find_callsite_slot(file, function, line, stack_hash);
+
+    if (callsite_index[slot]) {
+        return callsite_index[slot] - 1;
+    }
+
+    if (num_callsites == callsites_watermark) {
+        callsites_watermark += 256;
+        callsites = (Allocation_Callsite*) realloc(callsites, sizeof(Allocation_Callsite) * callsites_watermark);
+    }
+
+    Allocation_Callsite& callsite = callsites[num_callsites];
+    callsite.file = file;
+    callsite.function = function;
+    callsite.line = line;
+    callsite.stack_hash = stack_hash;
+    callsite.num_stack_frames = num_stack_frames;
+    callsite.live_bytes = 0;
+    callsite.peak_bytes = 0;
+    callsite.live_blocks = 0;
+    callsite.total_allocations = 0;
+
+    if (num_stack_frames) {
+        memcpy(callsite.stack_frames, stack_frames, num_stack_frames * sizeof(void*));
+    }
+
+    callsite_index[slot] = ++num_callsites;
+
+    return num_callsites - 1;
+}
+
+static void add_block_to_callsite(u32 callsite_index, size_t size) {
+    Allocation_Callsite& callsite = callsites[callsite_index];
+    callsite.live_bytes += size;
+    callsite.live_blocks++;
+    callsite.total_allocations++;
+    callsite.peak_bytes = MAX(callsite.peak_bytes, callsite.live_bytes);
+}
+
+static void remove_block_from_callsite(u32 callsite_index, size_t size) {
+    Allocation_Callsite& callsite = callsites[callsite_index];
+    callsite.live_bytes -= size;
+    callsite.live_blocks--;
+}
+
+static void add_block_to_tag(Memory_Tag tag, size_t size) {
+    Memory_Tag_Stats& stats = memory_tag_stats[tag];
+    stats.live_bytes += size;
+    stats.live_blocks++;
+    stats.peak_bytes = MAX(stats.peak_bytes, stats.live_bytes);
+}
+
+static void remove_block_from_tag(Memory_Tag tag, size_t size) {
+    Memory_Tag_Stats& stats = memory_tag_stats[tag];
+    stats.live_bytes -= size;
+    stats.live_blocks--;
+}
 
 static void bytes_to_human_readable_size(size_t bytes, float& out_size, const char*& out_unit) {
     static const char* sizes[] = { "B", "kB", "MB", "GB" };
@@ -32,46 +391,317 @@ static void bytes_to_human_readable_size(size_t bytes, float& out_size, const ch
     out_size = (float)bytes + (float)rem / 1024.0f;
 }
 
-void log_record(Memory_Record& record) {
-    const char* last_slash = strrchr(record.file, '/');
-    const char* file = last_slash ? (last_slash + 1) : record.file;
+static inline const char* file_name_without_path(const char* file) {
+    const char* last_slash = strrchr(file, '/');
 
+    return last_slash ? (last_slash + 1) : file;
+}
+
+static int compare_callsites(const void* ap, const void* bp) {
+    Allocation_Callsite* a = (Allocation_Callsite*) ap;
+    Allocation_Callsite* b = (Allocation_Callsite*) bp;
+
+    int result = 0;
+
+    switch (callsite_sort_type) {
+        case Callsite_Sort_Type_Location: {
+            result = strcmp(file_name_without_path(a->file), file_name_without_path(b->file));
+
+            if (!result) {
+                result = (int) a->line - (int) b->line;
+            }
+
+            break;
+        }
+
+        case Callsite_Sort_Type_Live_Bytes: result = (a->live_bytes > b->live_bytes) - (a->live_bytes < b->live_bytes); break;
+        case Callsite_Sort_Type_Live_Blocks: result = (a->live_blocks > b->live_blocks) - (a->live_blocks < b->live_blocks); break;
+        case Callsite_Sort_Type_Total_Allocations: result = (a->total_allocations > b->total_allocations) - (a->total_allocations < b->total_allocations); break;
+        case Callsite_Sort_Type_Peak_Bytes: result = (a->peak_bytes > b->peak_bytes) - (a->peak_bytes < b->peak_bytes); break;
+    }
+
+    return callsite_sort_descending ? -result : result;
+}
+
+static void draw_callsite_column_header(const char* name, Callsite_Sort_Type sort_type) {
+    bool is_selected = callsite_sort_type == sort_type;
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s %s", name, is_selected ? (callsite_sort_descending ? "v" : "^") : "");
+
+    if (ImGui::Selectable(label, is_selected)) {
+        if (is_selected) {
+            callsite_sort_descending = !callsite_sort_descending;
+        } else {
+            callsite_sort_type = sort_type;
+            callsite_sort_descending = sort_type != Callsite_Sort_Type_Location;
+        }
+    }
+
+    ImGui::NextColumn();
+}
+
+static void draw_human_readable_size_column(u64 bytes) {
     const char* unit = "";
     float size = 0.0f;
 
-    bytes_to_human_readable_size(record.size, size, unit);
+    bytes_to_human_readable_size(bytes, size, unit);
+
+    ImGui::Text("%.1f %s", size, unit);
+    ImGui::NextColumn();
+}
+
+#if MEMORY_TRACING == MEMORY_TRACING_SAMPLED && !EMSCRIPTEN
+// backtrace_symbols gives "binary(function+0x1f) [0x...]", we only want the function
+static String stack_frame_symbol_to_function_name(char* symbol) {
+    String result;
+    result.start = symbol;
+    result.length = strlen(symbol);
+
+    char* open_paren = strchr(symbol, '(');
+    char* plus = open_paren ? strchr(open_paren, '+') : NULL;
+
+    if (open_paren && plus && plus > open_paren + 1) {
+        result.start = open_paren + 1;
+        result.length = plus - result.start;
+    }
+
+    return result;
+}
+#endif
+
+/**
+ * Format is one line per callsite: "file;function:line live_bytes", which flamegraph.pl
+ *  and speedscope both understand as a collapsed stack. Sampled builds prepend the captured
+ *  stack (outermost frame first) and scale bytes by the sample rate.
+ */
+static void export_callsites_as_collapsed_stacks(Allocation_Callsite* snapshot, u32 length) {
+    // Rough upper bound per line, function names are the only unbounded part
+    u32 buffer_size = 0;
+    u32 weight_scale = MEMORY_TRACING == MEMORY_TRACING_SAMPLED ? MEMORY_TRACING_SAMPLE_RATE : 1;
+
+    for (Allocation_Callsite* it = snapshot; it != snapshot + length; it++) {
+        buffer_size += strlen(it->file) + strlen(it->function) + 48 + it->num_stack_frames * 256;
+    }
+
+    char* buffer = (char*) talloc(buffer_size);
+    u32 written = 0;
+
+    for (Allocation_Callsite* it = snapshot; it != snapshot + length; it++) {
+        if (!it->live_bytes) {
+            continue;
+        }
+
+#if MEMORY_TRACING == MEMORY_TRACING_SAMPLED && !EMSCRIPTEN
+        if (it->num_stack_frames) {
+            char** symbols = backtrace_symbols(it->stack_frames, it->num_stack_frames);
+
+            // First two frames are the tracker itself
+            for (s32 frame = it->num_stack_frames - 1; frame >= 2 && symbols; frame--) {
+                String name = stack_frame_symbol_to_function_name(symbols[frame]);
+
+                written += snprintf(buffer + written, buffer_size - written, "%.*s;", MIN(name.length, 200), name.start);
+            }
+
+            free(symbols);
+        }
+#endif
+
+        written += snprintf(buffer + written, buffer_size - written, "%s;%s:%u %llu\n",
+                            file_name_without_path(it->file), it->function, it->line,
+                            (unsigned long long) it->live_bytes * weight_scale);
+    }
+
+    platform_write_file(collapsed_stacks_file_path, buffer, written, false);
+
+    printf("Exported %i allocation callsites to %s\n", length, collapsed_stacks_file_path);
+}
+
+static void draw_memory_tags(Memory_Tag_Stats* stats) {
+    ImGui::Columns(4, "memory_tags");
+
+    ImGui::Text("Tag");
+    ImGui::NextColumn();
+    ImGui::Text("Live");
+    ImGui::NextColumn();
+    ImGui::Text("Blocks");
+    ImGui::NextColumn();
+    ImGui::Text("Peak");
+    ImGui::NextColumn();
+
+    ImGui::Separator();
+
+    for (u32 tag = 0; tag < Memory_Tag_Count; tag++) {
+        ImGui::Text("%s", memory_tag_names[tag]);
+        ImGui::NextColumn();
+
+        draw_human_readable_size_column(stats[tag].live_bytes);
 
-    ImGui::Text("%s:%i %s %p %.1f %s", file, record.line, record.function, record.pointer, size, unit);
+        ImGui::Text("%u", stats[tag].live_blocks);
+        ImGui::NextColumn();
+
+        draw_human_readable_size_column(stats[tag].peak_bytes);
+    }
+
+    ImGui::Columns(1);
+    ImGui::Separator();
+}
+
+void write_memory_metrics_if_necessary() {
+    if (memory_metrics_written_at && platform_get_delta_time_ms(memory_metrics_written_at) < memory_metrics_interval_ms) {
+        return;
+    }
+
+    memory_metrics_written_at = platform_get_app_time_precise();
+
+    Memory_Tag_Stats stats[Memory_Tag_Count];
+
+    lock_memory_records();
+    memcpy(stats, memory_tag_stats, sizeof(stats));
+    unlock_memory_records();
+
+    char buffer[2048];
+    u32 written = 0;
+
+    // Truncates whatever was left from the previous run
+    if (!memory_metrics_header_written) {
+        memory_metrics_started_at = memory_metrics_written_at;
+
+        written += snprintf(buffer + written, sizeof(buffer) - written, "time_ms");
+
+        for (u32 tag = 0; tag < Memory_Tag_Count; tag++) {
+            written += snprintf(buffer + written, sizeof(buffer) - written, ",%s live,%s peak", memory_tag_names[tag], memory_tag_names[tag]);
+        }
+
+        written += snprintf(buffer + written, sizeof(buffer) - written, "\n");
+    }
+
+    written += snprintf(buffer + written, sizeof(buffer) - written, "%.0f", platform_get_delta_time_ms(memory_metrics_started_at));
+
+    for (u32 tag = 0; tag < Memory_Tag_Count; tag++) {
+        written += snprintf(buffer + written, sizeof(buffer) - written, ",%llu,%llu", stats[tag].live_bytes, stats[tag].peak_bytes);
+    }
+
+    written += snprintf(buffer + written, sizeof(buffer) - written, "\n");
+
+    platform_write_file(memory_metrics_file_path, buffer, MIN(written, (u32) sizeof(buffer) - 1), memory_metrics_header_written);
+
+    memory_metrics_header_written = true;
 }
 
 void draw_memory_records() {
+    Memory_Tag_Stats tag_stats[Memory_Tag_Count];
+
+    lock_memory_records();
+
+    memcpy(tag_stats, memory_tag_stats, sizeof(tag_stats));
+
+    if (callsites_snapshot_watermark < num_callsites) {
+        callsites_snapshot_watermark = callsites_watermark;
+        callsites_snapshot = (Allocation_Callsite*) realloc(callsites_snapshot, sizeof(Allocation_Callsite) * callsites_snapshot_watermark);
+    }
+
+    u32 snapshot_length = num_callsites;
+    u32 total_blocks = history_length;
+    u64 total_memory = total_allocated_memory;
+
+    memcpy(callsites_snapshot, callsites, sizeof(Allocation_Callsite) * snapshot_length);
+
+    unlock_memory_records();
+
     const char* unit = "";
     float size = 0.0f;
 
-    bytes_to_human_readable_size(total_allocated_memory, size, unit);
+    bytes_to_human_readable_size(total_memory, size, unit);
 
     ImGui::Text("Total memory occupied: %.1f %s", size, unit);
-    ImGui::Text("Total blocks: %i", history_length);
+    ImGui::Text("Total blocks: %i, callsites: %i", total_blocks, snapshot_length);
 
-    for (u32 index = 0; index < history_length; index++) {
-        log_record(memory_records[index]);
+#if MEMORY_TRACING == MEMORY_TRACING_SAMPLED
+    ImGui::Text("Sampled mode, only every %ith allocation is recorded", MEMORY_TRACING_SAMPLE_RATE);
+#endif
+
+    draw_memory_tags(tag_stats);
+
+    if (ImGui::Button("Export collapsed stacks")) {
+        export_callsites_as_collapsed_stacks(callsites_snapshot, snapshot_length);
+    }
+
+    qsort(callsites_snapshot, snapshot_length, sizeof(Allocation_Callsite), compare_callsites);
+
+    ImGui::Columns(5, "memory_callsites");
+
+    draw_callsite_column_header("Callsite", Callsite_Sort_Type_Location);
+    draw_callsite_column_header("Live", Callsite_Sort_Type_Live_Bytes);
+    draw_callsite_column_header("Blocks", Callsite_Sort_Type_Live_Blocks);
+    draw_callsite_column_header("Allocations", Callsite_Sort_Type_Total_Allocations);
+    draw_callsite_column_header("Peak", Callsite_Sort_Type_Peak_Bytes);
+
+    ImGui::Separator();
+
+    ImGuiListClipper clipper(snapshot_length);
+
+    while (clipper.Step()) {
+        for (Allocation_Callsite* it = callsites_snapshot + clipper.DisplayStart; it != callsites_snapshot + clipper.DisplayEnd; it++) {
+            ImGui::Text("%s:%i %s", file_name_without_path(it->file), it->line, it->function);
+            ImGui::NextColumn();
+
+            draw_human_readable_size_column(it->live_bytes);
+
+            ImGui::Text("%u", it->live_blocks);
+            ImGui::NextColumn();
+
+            ImGui::Text("%u", it->total_allocations);
+            ImGui::NextColumn();
+
+            draw_human_readable_size_column(it->peak_bytes);
+        }
     }
+
+    clipper.End();
+
+    ImGui::Columns(1);
 }
 
 static void record_memory(void* pointer, const char* file, const char* function, u32 line, size_t size) {
+#if MEMORY_TRACING == MEMORY_TRACING_SAMPLED
+    if (!should_sample_allocation()) {
+        return;
+    }
+
+    void* stack_frames[max_callsite_stack_frames];
+    u32 num_stack_frames = capture_stack(stack_frames);
+#else
+    void** stack_frames = NULL;
+    u32 num_stack_frames = 0;
+#endif
+
+    lock_memory_records();
+
     Memory_Record record;
     record.pointer = pointer;
     record.size = size;
-    record.file = file;
-    record.line = line;
-    record.function = function;
+    record.callsite = find_or_add_callsite(file, function, line, stack_frames, num_stack_frames);
+    record.tag = current_memory_tag;
+
+    add_block_to_callsite(record.callsite, size);
+    add_block_to_tag(record.tag, size);
 
     if (history_length == history_watermark) {
         history_watermark += 1000;
         memory_records = (Memory_Record*) realloc(memory_records, sizeof(Memory_Record) * history_watermark);
     }
 
+    if ((history_length + 1) * 2 > pointer_index_size) {
+        grow_pointer_index();
+    }
+
     memory_records[history_length++] = record;
+    pointer_index[find_pointer_slot(pointer)] = history_length;
+
+    total_allocated_memory += size;
+
+    unlock_memory_records();
 }
 
 /*
@@ -101,9 +731,9 @@ static void record_memory(void* pointer, const char* file, u32 line, size_t size
 }*/
 
 void* malloc_and_log(const char* file, const char* function, u32 line, size_t size) {
-    void* pointer = malloc(size);
+    heap_allocation_count++;
 
-    total_allocated_memory += size;
+    void* pointer = malloc(size);
 
     record_memory(pointer, file, function, line, size);
 
@@ -111,9 +741,9 @@ void* malloc_and_log(const char* file, const char* function, u32 line, size_t si
 }
 
 void* calloc_and_log(const char* file, const char* function, u32 line, size_t num, size_t size) {
-    void* pointer = calloc(num, size);
+    heap_allocation_count++;
 
-    total_allocated_memory += size * num;
+    void* pointer = calloc(num, size);
 
     record_memory(pointer, file, function, line, size * num);
 
@@ -122,26 +752,54 @@ void* calloc_and_log(const char* file, const char* function, u32 line, size_t nu
 
 void* realloc_and_log(const char* file, const char* function, u32 line, void* realloc_what, size_t new_size) {
     if (realloc_what) {
+        heap_allocation_count++;
+
+        // Held across realloc, otherwise another thread could get the old pointer from malloc before we update the record
+        lock_memory_records();
+
         void* pointer = realloc(realloc_what, new_size);
 
-        for (u32 index = 0; index < history_length; index++) {
-            Memory_Record& old_record = memory_records[index];
+        u32 slot;
+        Memory_Record* old_record = find_record(realloc_what, slot);
+
+        if (old_record) {
+            total_allocated_memory -= old_record->size;
+            total_allocated_memory += new_size;
+
+            // Block now belongs to whoever resized it last, but stays in the subsystem which allocated it
+            remove_block_from_callsite(old_record->callsite, old_record->size);
+            remove_block_from_tag(old_record->tag, old_record->size);
 
-            if (old_record.pointer == realloc_what) {
-                old_record.pointer = pointer;
+            // Keep the stack of the original sampled allocation, copied since callsites can move while adding
+            void* stack_frames[max_callsite_stack_frames];
+            u32 num_stack_frames = callsites[old_record->callsite].num_stack_frames;
+            memcpy(stack_frames, callsites[old_record->callsite].stack_frames, num_stack_frames * sizeof(void*));
 
-                total_allocated_memory -= old_record.size;
-                total_allocated_memory += new_size;
+            old_record->size = new_size;
+            old_record->callsite = find_or_add_callsite(file, function, line, stack_frames, num_stack_frames);
 
-                old_record.size = new_size;
-                old_record.file = file;
-                old_record.line = line;
+            add_block_to_callsite(old_record->callsite, new_size);
+            add_block_to_tag(old_record->tag, new_size);
 
-                return pointer;
+            if (pointer != realloc_what) {
+                u32 record_index_plus_one = pointer_index[slot];
+
+                remove_pointer_slot(slot);
+
+                old_record->pointer = pointer;
+                pointer_index[find_pointer_slot(pointer)] = record_index_plus_one;
             }
+
+            unlock_memory_records();
+
+            return pointer;
         }
 
+        unlock_memory_records();
+
+#if MEMORY_TRACING == MEMORY_TRACING_FULL
         printf("WARNING: Reallocation of an unmanaged pointer %p with size %zu at %s %s:%i\n", realloc_what, new_size, function, file, line);
+#endif
 
         return pointer;
     } else {
@@ -150,23 +808,30 @@ void* realloc_and_log(const char* file, const char* function, u32 line, void* re
 }
 
 void free_and_log(const char* file, const char* function, u32 line, void* free_what) {
+    lock_memory_records();
+
     free(free_what);
 
-    for (u32 index = 0; index < history_length; index++) {
-        Memory_Record& old_record = memory_records[index];
+    u32 slot;
+    Memory_Record* old_record = find_record(free_what, slot);
 
-        if (old_record.pointer == free_what) {
-            total_allocated_memory -= old_record.size;
+    if (old_record) {
+        total_allocated_memory -= old_record->size;
 
-            if (history_length > 1) {
-                old_record = memory_records[history_length - 1];
-            }
+        remove_block_from_callsite(old_record->callsite, old_record->size);
+        remove_block_from_tag(old_record->tag, old_record->size);
+        remove_record(slot);
 
-            history_length--;
+        unlock_memory_records();
 
-            return;
-        }
+        return;
     }
 
+    unlock_memory_records();
+
+#if MEMORY_TRACING == MEMORY_TRACING_FULL
     printf("WARNING: Freeing of an unmanaged pointer %p at %s %s:%i\n", free_what, function, file, line);
-}
\ No newline at end of file
+#endif
+}
+
+#endif
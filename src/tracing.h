@@ -2,4 +2,37 @@
 
 #include "common.h"
 
-void draw_memory_records();
\ No newline at end of file
+/**
+ * Allocations are tagged with the tag current on the allocating thread at the time, so subsystems
+ *  set their tag around the code which builds their data. Blocks keep their tag through reallocation.
+ */
+enum Memory_Tag {
+    Memory_Tag_Other,
+    Memory_Tag_Json,
+    Memory_Tag_Json_Tokens,
+    Memory_Tag_Task_Model,
+    Memory_Tag_Folder_Tree,
+    Memory_Tag_Users,
+    Memory_Tag_Rich_Text,
+    Memory_Tag_Images,
+    Memory_Tag_ImGui,
+    Memory_Tag_Temporary_Storage,
+    Memory_Tag_Count
+};
+
+// Returns the previous tag, so it can be restored after
+Memory_Tag set_memory_tag(Memory_Tag tag);
+
+// For ImGui::SetAllocatorFunctions, tags everything ImGui allocates
+void* imgui_malloc_wrapper(size_t size, void* user_data);
+void imgui_free_wrapper(void* ptr, void* user_data);
+
+void draw_memory_records();
+
+// Appends live and peak bytes per tag to the metrics file every now and then, called once per frame
+void write_memory_metrics_if_necessary();
+
+// Heap allocations made by the calling thread since the previous call, always 0 with raw memory tracing
+u32 take_heap_allocation_count();
+
+const char* memory_tracing_mode_name();
@@ -90,9 +90,11 @@ void draw_loading_spinner(ImDrawList* draw_list, ImVec2 top_left, float radius,
 }
 
 void draw_circular_user_avatar(ImDrawList* draw_list, User* user, ImVec2 top_left, float avatar_side_px) {
-    if (check_and_request_user_avatar_if_necessary(user)) {
+    u32 texture_id;
+
+    if (check_and_request_user_avatar_if_necessary(user, texture_id)) {
         float half_avatar_side = avatar_side_px / 2.0f;
-        ImTextureID avatar_texture_id = (ImTextureID)(intptr_t) user->avatar.texture_id;
+        ImTextureID avatar_texture_id = (ImTextureID)(intptr_t) texture_id;
 
         u32 avatar_color = 0x00FFFFFF;
         u32 alpha = (u32) roundf(lerp(user->avatar_loaded_at, tick, 255, 14));
@@ -1,23 +1,22 @@
 #include "users.h"
 #include "json.h"
-#include "id_hash_map.h"
+#include "avatar_cache.h"
+#include "interned_strings.h"
 
-Array<User> users{};
-Array<User> suggested_users{};
+Array<User*> users{};
+Array<User*> suggested_users{};
 
 User* this_user = NULL;
 
-static Id_Hash_Map<User_Id, User*> id_to_user_map{};
+Entity_Store<User> user_store{};
 
-static User* process_users_data_object(Array<User>& target_users, char* json, jsmntok_t*&token) {
+static User* process_users_data_object(char* json, jsmntok_t*&token) {
     jsmntok_t* object_token = token++;
 
     assert(object_token->type == JSMN_OBJECT);
 
-    User* user = &target_users[target_users.length++];
-
-    user->avatar_request_id = NO_REQUEST;
-    user->avatar = {};
+    User parsed{};
+    bool is_me = false;
 
     for (u32 propety_index = 0; propety_index < object_token->size; propety_index++, token++) {
         jsmntok_t* property_token = token++;
@@ -27,95 +26,125 @@ static User* process_users_data_object(Array<User>& target_users, char* json, js
         jsmntok_t* next_token = token;
 
         if (json_string_equals(json, property_token, "id")) {
-            json_token_to_id8(json, next_token, user->id);
+            json_token_to_id8(json, next_token, parsed.id);
         } else if (json_string_equals(json, property_token, "firstName")) {
-            json_token_to_string(json, next_token, user->first_name);
+            json_token_to_interned_string(json, next_token, parsed.first_name);
         } else if (json_string_equals(json, property_token, "lastName")) {
-            json_token_to_string(json, next_token, user->last_name);
+            json_token_to_interned_string(json, next_token, parsed.last_name);
         } else if (json_string_equals(json, property_token, "avatarUrl")) {
-            json_token_to_string(json, next_token, user->avatar_url);
+            json_token_to_interned_string(json, next_token, parsed.avatar_url);
         } else if (json_string_equals(json, property_token, "me")) {
-            // TODO This can and will happen twice because this user can occur
-            // TODO     both in the suggested list and in the contacts list
-            // TODO     a good solution is using a centralized 'truth' source
-            // TODO     for all users
-            if (!this_user && *(json + next_token->start) == 't') {
-                this_user = user;
-            }
+            is_me = *(json + next_token->start) == 't';
         } else {
             eat_json(token);
             token--;
         }
     }
 
+    Entity_Index index;
+    bool is_new;
+
+    // Contacts and suggestions share users, a user which is already there keeps its avatar state
+    User* user = entity_store_get_or_add(user_store, parsed.id, index, is_new);
+
+    if (is_new) {
+        user->id = parsed.id;
+        user->avatar_request_id = NO_REQUEST;
+    }
+
+    // Strings are interned, same contents means same pointer
+    bool names_changed = user->first_name.start != parsed.first_name.start || user->last_name.start != parsed.last_name.start;
+    bool avatar_changed = user->avatar_url.start != parsed.avatar_url.start;
+
+    if (names_changed || avatar_changed) {
+        user->first_name = parsed.first_name;
+        user->last_name = parsed.last_name;
+
+        if (avatar_changed) {
+            user->avatar_url = parsed.avatar_url;
+            user->avatar_url_hash = hash_avatar_url(user->avatar_url);
+            user->avatar_loaded_at = 0;
+        }
+
+        if (!is_new) {
+            entity_touch(user_store.registry, index);
+        }
+    }
+
+    if (is_me) {
+        this_user = user;
+    }
+
     return user;
 }
 
 void process_users_data(char* json, u32 data_size, jsmntok_t*&token) {
     if (users.length < data_size) {
-        users.data = (User*) REALLOC(users.data, sizeof(User) * data_size);
-    }
-
-    if (id_to_user_map.table) {
-        id_hash_map_destroy(&id_to_user_map);
+        users.data = (User**) REALLOC(users.data, sizeof(User*) * data_size);
     }
 
-    id_hash_map_init(&id_to_user_map);
-
     users.length = 0;
 
     for (u32 array_index = 0; array_index < data_size; array_index++) {
-        User* user = process_users_data_object(users, json, token);
-
-        id_hash_map_put(&id_to_user_map, user, user->id, hash_id(user->id));;
+        users[users.length++] = process_users_data_object(json, token);
     }
 }
 
 void process_suggested_users_data(char* json, u32 data_size, jsmntok_t*&token) {
     if (suggested_users.length < data_size) {
-        suggested_users.data = (User*) REALLOC(suggested_users.data, sizeof(User) * data_size);
+        suggested_users.data = (User**) REALLOC(suggested_users.data, sizeof(User*) * data_size);
     }
 
     suggested_users.length = 0;
 
     for (u32 array_index = 0; array_index < data_size; array_index++) {
-        process_users_data_object(suggested_users, json, token);
+        suggested_users[suggested_users.length++] = process_users_data_object(json, token);
     }
 }
 
-bool check_and_request_user_avatar_if_necessary(User* user) {
-    if (!user->avatar.texture_id) {
-        if (user->avatar_request_id == NO_REQUEST) {
-            image_request(user->avatar_request_id, "%.*s", user->avatar_url.length, user->avatar_url.start);
-        }
-
+bool check_and_request_user_avatar_if_necessary(User* user, u32& out_texture_id) {
+    // Don't hit the network for avatars which might be sitting on disk already
+    if (!avatar_cache_finished_loading()) {
         return false;
     }
 
-    return true;
-}
+    out_texture_id = avatar_cache_get_texture_for_drawing(user->avatar_url_hash);
 
-// Naive and slow, don't use too often
-User* find_user_by_avatar_request_id(Request_Id avatar_request_id) {
-    for (User* it = suggested_users.data; it != suggested_users.data + suggested_users.length; it++) {
-        if (it->avatar_request_id == avatar_request_id) {
-            return it;
+    if (out_texture_id) {
+        // Only fade in once, textures reloaded after eviction should just pop back
+        if (!user->avatar_loaded_at) {
+            user->avatar_loaded_at = tick;
         }
+
+        return true;
     }
 
-    for (User* it = users.data; it != users.data + users.length; it++) {
-        if (it->avatar_request_id == avatar_request_id) {
-            return it;
-        }
+    // Avatars which didn't fit into the cache file are dropped when memory runs out
+    if (avatar_cache_take_forgotten(user->avatar_url_hash)) {
+        user->avatar_request_id = NO_REQUEST;
     }
 
-    return NULL;
-}
+    if (user->avatar_request_id == NO_REQUEST) {
+        Image_Consumer consumer;
+        consumer.type = Image_Consumer_User_Avatar;
+        consumer.avatar_url_hash = user->avatar_url_hash;
 
-User* find_user_by_id(User_Id id, u32 id_hash) {
-    if (!id_hash) {
-        id_hash = hash_id(id);
+        image_request(user->avatar_request_id, consumer, "%.*s", user->avatar_url.length, user->avatar_url.start);
     }
 
-    return id_hash_map_get(&id_to_user_map, id, id_hash);
-}
\ No newline at end of file
+    return false;
+}
+
+User* find_user_by_id(User_Id id) {
+    return entity_get(user_store.registry, entity_find(user_store.registry, id));
+}
+
+void keep_user_interned_strings() {
+    for (u32 index = 0; index < user_store.values.length; index++) {
+        User& user = user_store.values[index];
+
+        keep_interned_string(user.first_name);
+        keep_interned_string(user.last_name);
+        keep_interned_string(user.avatar_url);
+    }
+}
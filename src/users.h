@@ -2,6 +2,7 @@
 #include "common.h"
 #include "temporary_storage.h"
 #include "main.h"
+#include "entity_registry.h"
 
 #pragma once
 
@@ -10,24 +11,26 @@ struct User {
     String first_name;
     String last_name;
     String avatar_url;
+    u64 avatar_url_hash;
 
     Request_Id avatar_request_id;
-    Memory_Image avatar{};
     u32 avatar_loaded_at;
 };
 
-extern Array<User> users;
-extern Array<User> suggested_users;
+// Both are views into user_store, the same user can be in both
+extern Array<User*> users;
+extern Array<User*> suggested_users;
+extern Entity_Store<User> user_store;
 
 extern User* this_user;
 
 void process_users_data(char* json, u32 data_size, jsmntok_t*& token);
 void process_suggested_users_data(char* json, u32 data_size, jsmntok_t*&token);
 
-User* find_user_by_id(User_Id id, u32 id_hash = 0);
-User* find_user_by_avatar_request_id(Request_Id avatar_request_id);
+User* find_user_by_id(User_Id id);
+void keep_user_interned_strings();
 
-bool check_and_request_user_avatar_if_necessary(User* user);
+bool check_and_request_user_avatar_if_necessary(User* user, u32& out_texture_id);
 
 inline String full_user_name_to_temporary_string(User* user) {
     // This function used tprintf("%.*s %.*s", ...) earlier, but turns out snprintf is ridiculously slow
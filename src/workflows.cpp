@@ -1,12 +1,14 @@
 #include <jsmn.h>
 #include "json.h"
-#include "id_hash_map.h"
+#include "entity_registry.h"
 #include "workflows.h"
+#include "interned_strings.h"
 
 Array<Workflow> workflows{};
 
+Entity_Registry<Custom_Status> custom_status_registry{};
+
 static Array<Custom_Status> custom_statuses{};
-static Id_Hash_Map<Custom_Status_Id, Custom_Status*> id_to_custom_status = {};
 
 static u32 color_name_to_color_argb(String &color_name) {
     char c = *color_name.start;
@@ -117,7 +119,7 @@ static void process_custom_status(Workflow* workflow, char* json, jsmntok_t*& to
         if (json_string_equals(json, property_token, "id")) {
             json_token_to_right_part_of_id16(json, next_token, custom_status->id);
         } else if (json_string_equals(json, property_token, "name")) {
-            json_token_to_string(json, next_token, custom_status->name);
+            json_token_to_interned_string(json, next_token, custom_status->name);
         } else if (json_string_equals(json, property_token, "standard")) {
             is_standard = *(json + next_token->start) == 't';
         } else if (json_string_equals(json, property_token, "hidden")) {
@@ -142,9 +144,7 @@ static void process_custom_status(Workflow* workflow, char* json, jsmntok_t*& to
         custom_status->color = argb_to_agbr(status_group_to_color(custom_status->group));
     }
 
-    custom_status->id_hash = hash_id(custom_status->id);
-
-    id_hash_map_put(&id_to_custom_status, custom_status, custom_status->id, custom_status->id_hash);
+    entity_set(custom_status_registry, entity_register(custom_status_registry, custom_status->id), custom_status);
 }
 
 void process_workflows_data(char* json, u32 data_size, jsmntok_t*&token) {
@@ -175,10 +175,7 @@ void process_workflows_data(char* json, u32 data_size, jsmntok_t*&token) {
 
     token = json_start;
 
-    // TODO hacky, we need to clear the map when it's populated too
-    if (id_to_custom_status.size == 0) {
-        id_hash_map_init(&id_to_custom_status);
-    }
+    entity_registry_forget_entities(custom_status_registry);
 
     if (workflows.length < data_size) {
         workflows.data = (Workflow*) REALLOC(workflows.data, sizeof(Workflow) * data_size);
@@ -208,7 +205,7 @@ void process_workflows_data(char* json, u32 data_size, jsmntok_t*&token) {
             if (json_string_equals(json, property_token, "id")) {
                 json_token_to_right_part_of_id16(json, next_token, workflow->id);
             } else if (json_string_equals(json, property_token, "name")) {
-                json_token_to_string(json, next_token, workflow->name);
+                json_token_to_interned_string(json, next_token, workflow->name);
             } else if (json_string_equals(json, property_token, "customStatuses")) {
                 assert(next_token->type == JSMN_ARRAY);
 
@@ -230,10 +227,16 @@ void process_workflows_data(char* json, u32 data_size, jsmntok_t*&token) {
     }
 }
 
-Custom_Status* find_custom_status_by_id(Custom_Status_Id id, u32 id_hash) {
-    if (!id_hash) {
-        id_hash = hash_id(id);
+Custom_Status* find_custom_status_by_id(Custom_Status_Id id) {
+    return entity_get(custom_status_registry, entity_find(custom_status_registry, id));
+}
+
+void keep_workflow_interned_strings() {
+    for (u32 index = 0; index < workflows.length; index++) {
+        keep_interned_string(workflows[index].name);
     }
 
-    return id_hash_map_get(&id_to_custom_status, id, id_hash);
-}
\ No newline at end of file
+    for (u32 index = 0; index < custom_statuses.length; index++) {
+        keep_interned_string(custom_statuses[index].name);
+    }
+}
@@ -1,5 +1,6 @@
 
 #include "common.h"
+#include "entity_registry.h"
 
 enum Status_Group {
     Status_Group_Invalid,
@@ -16,7 +17,6 @@ struct Custom_Status {
     Custom_Status_Id id;
     String name;
     Status_Group group;
-    u32 id_hash;
     u32 color;
     u32 natural_index;
     bool is_hidden;
@@ -29,6 +29,8 @@ struct Workflow {
 };
 
 extern Array<Workflow> workflows;
+extern Entity_Registry<Custom_Status> custom_status_registry;
 
 void process_workflows_data(char* json, u32 data_size, jsmntok_t*&token);
-Custom_Status* find_custom_status_by_id(Custom_Status_Id id, u32 id_hash = 0);
\ No newline at end of file
+Custom_Status* find_custom_status_by_id(Custom_Status_Id id);
+void keep_workflow_interned_strings();
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include <cstdio>
+#include "../src/lazy_array.h"
+#include "../src/handle_pool.h"
+
+// Colors in common.h are initialized with it, the rest of common.cpp needs the platform
+u32 argb_to_agbr(u32 argb) {
+    return argb;
+}
+
+static u32 failures = 0;
+
+#define CHECK(condition) check(condition, #condition, __LINE__)
+
+static void check(bool condition, const char* text, u32 line) {
+    if (!condition) {
+        printf("block_array_test.cpp:%u: %s\n", line, text);
+        failures++;
+    }
+}
+
+// Values written through the returned pointer have to read back through indexing, and the other way around
+template <u32 block_size>
+static void fill_and_check(Block_Array<u32, block_size>& array, u32 n, u32 seed) {
+    u32 offset = block_array_reserve_n_values_and_get_offset(array, n);
+    u32* values = &array[offset];
+
+    for (u32 index = 0; index < n; index++) {
+        values[index] = seed + index;
+    }
+
+    for (u32 index = 0; index < n; index++) {
+        CHECK(array[offset + index] == seed + index);
+    }
+}
+
+static void test_reservations_bigger_than_a_block() {
+    Block_Array<u32, 16> array{};
+
+    fill_and_check(array, 5, 0);
+    fill_and_check(array, 40, 100);
+    fill_and_check(array, 16, 200);
+    fill_and_check(array, 3, 300);
+
+    // Earlier values stay where they were
+    CHECK(array[0] == 0);
+    CHECK(array[4] == 4);
+
+    block_array_clear(array);
+}
+
+static void test_reuse_after_soft_reset() {
+    Block_Array<u32, 16> array{};
+
+    fill_and_check(array, 10, 0);
+    fill_and_check(array, 100, 1000);
+    fill_and_check(array, 10, 2000);
+
+    block_array_soft_reset(array);
+
+    // Fits into the big allocation from before the reset
+    fill_and_check(array, 10, 3000);
+    fill_and_check(array, 60, 4000);
+    fill_and_check(array, 10, 5000);
+
+    block_array_soft_reset(array);
+
+    // Starts in the middle of the big allocation and needs more than the rest of it
+    fill_and_check(array, 16, 6000);
+    fill_and_check(array, 16, 7000);
+    fill_and_check(array, 200, 8000);
+    fill_and_check(array, 1, 9000);
+
+    CHECK(array[0] == 6000);
+    CHECK(array[16] == 7000);
+
+    block_array_soft_reset(array);
+
+    fill_and_check(array, 300, 10000);
+
+    block_array_clear(array);
+}
+
+static void test_range_pool_longer_than_a_block() {
+    Range_Pool<u32> pool{};
+
+    Range_Handle<u32> small = range_pool_reserve(pool, 3);
+    Range_Handle<u32> big = range_pool_reserve(pool, range_pool_block_size * 2 + 5);
+
+    u32* small_values = range_pool_get(pool, small);
+    u32* big_values = range_pool_get(pool, big);
+
+    for (u32 index = 0; index < small.length; index++) {
+        small_values[index] = index;
+    }
+
+    for (u32 index = 0; index < big.length; index++) {
+        big_values[index] = index * 3;
+    }
+
+    CHECK(range_pool_get(pool, small)[2] == 2);
+    CHECK(range_pool_get(pool, big)[big.length - 1] == (big.length - 1) * 3);
+
+    block_array_clear(pool.values);
+}
+
+static void test_range_pool_reuses_released_ranges() {
+    Range_Pool<u32> pool{};
+
+    Range_Handle<u32> first = range_pool_reserve(pool, 2);
+    Range_Handle<u32> second = range_pool_reserve(pool, 2);
+    Range_Handle<u32> other_length = range_pool_reserve(pool, 3);
+
+    range_pool_get(pool, second)[0] = 42;
+
+    range_pool_release(pool, first);
+    range_pool_release(pool, other_length);
+
+    u32 length_before = pool.values.length;
+
+    // Last released goes first, and only to reservations of the same length
+    Range_Handle<u32> reused = range_pool_reserve(pool, 2);
+    Range_Handle<u32> fresh = range_pool_reserve(pool, 2);
+    Range_Handle<u32> reused_other_length = range_pool_reserve(pool, 3);
+
+    CHECK(reused.offset == first.offset);
+    CHECK(fresh.offset == length_before);
+    CHECK(reused_other_length.offset == other_length.offset);
+    CHECK(range_pool_get(pool, second)[0] == 42);
+
+    range_pool_release(pool, reused);
+    range_pool_reset(pool);
+
+    // Nothing released before the reset is handed out again
+    CHECK(range_pool_reserve(pool, 2).offset == 0);
+
+    block_array_clear(pool.values);
+}
+
+int main() {
+    test_reservations_bigger_than_a_block();
+    test_reuse_after_soft_reset();
+    test_range_pool_longer_than_a_block();
+    test_range_pool_reuses_released_ranges();
+
+    if (failures) {
+        printf("%u checks failed\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
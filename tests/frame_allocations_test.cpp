@@ -0,0 +1,131 @@
+#include <cstdio>
+#include <cstring>
+#include "../src/common.h"
+#include "../src/platform.h"
+#include "../src/tracing.h"
+#include "../src/temporary_storage.h"
+#include "../src/json.h"
+#include "../src/accounts.h"
+#include "../src/task_list.h"
+
+/**
+ * Once everything is loaded and warmed up, a frame shouldn't touch the heap. Runs the per-frame paths which
+ *  used to allocate every frame and checks the per-thread heap allocation count stays at 0.
+ * Needs a MEMORY_TRACING mode other than RAW, the count is always 0 there.
+ */
+
+static const u32 warm_up_frames = 10;
+static const u32 checked_frames = 100;
+
+static char accounts_json[] =
+        "{\"kind\":\"accounts\",\"data\":[{\"id\":\"AAAAAAAB\",\"customFields\":["
+        "{\"id\":\"AAAAAAAAAAAAAAAH\",\"title\":\"Estimate\",\"type\":\"Numeric\"},"
+        "{\"id\":\"AAAAAAAAAAAAAAAL\",\"title\":\"Customer\",\"type\":\"Text\"}]}]}";
+
+static char folder_header_json[] =
+        "{\"kind\":\"folders\",\"data\":[{\"title\":\"Folder\",\"customColumnIds\":[\"AAAAAAAAAAAAAAAH\",\"AAAAAAAAAAAAAAAL\"]}]}";
+
+// Nothing here talks to the outside world, the paths under test don't need a window or the network
+bool platform_init() { return true; }
+void platform_loop() {}
+void platform_begin_frame() {}
+void platform_end_frame() {}
+float platform_get_pixel_ratio() { return 1.0f; }
+u64 platform_get_app_time_precise() { return 0; }
+float platform_get_delta_time_ms(u64 delta_to) { return 0.0f; }
+void platform_open_url(String& permalink) {}
+void platform_api_request(Request_Id request_id, char* url, Http_Method method, void* data) {}
+void platform_load_remote_image(Request_Id request_id, char* full_url) {}
+void platform_load_file(Request_Id request_id, const char* path) {}
+void platform_write_file(const char* path, void* data, u32 data_length, bool append) {}
+bool platform_read_file_range(const char* path, u32 offset, void* data, u32 data_length) { return false; }
+void platform_local_storage_set(const char* key, String value) {}
+char* platform_local_storage_get(const char* key) { return NULL; }
+u32 platform_get_num_workers() { return 0; }
+void platform_run_job(Platform_Job job, void* data) { job(data, 0); }
+
+void platform_run_jobs_and_wait(Platform_Job job, void* data, u32 num_jobs) {
+    for (u32 index = 0; index < num_jobs; index++) {
+        job(data, index);
+    }
+}
+
+static void process_mock_response(char* json, Data_Process_Callback callback) {
+    u32 num_tokens;
+    jsmntok_t* tokens = parse_json_into_tokens(json, (u32) strlen(json), num_tokens);
+
+    process_json_data_segment(json, tokens, num_tokens, callback);
+
+    FREE(tokens);
+}
+
+static void run_frame(u32 frame) {
+    clear_temporary_storage();
+
+    ImGui::NewFrame();
+    ImGui::Begin("Frame allocations test");
+
+    Custom_Field** column_to_custom_field = map_columns_to_custom_fields();
+
+    for (u32 column = 0; column < 2; column++) {
+        Custom_Field* field = column_to_custom_field[column];
+
+        char* start, *end;
+
+        tprintf("%.*s %u", &start, &end, field->title.length, field->title.start, frame);
+
+        ImGui::TextUnformatted(start, end);
+    }
+
+    String label = tprintf("Frame %u", frame);
+
+    ImGui::Button(label.start);
+    ImGui::End();
+    ImGui::Render();
+}
+
+int main() {
+    init_temporary_storage();
+
+    ImGui::SetAllocatorFunctions(imgui_malloc_wrapper, imgui_free_wrapper);
+    ImGui::CreateContext();
+
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(1280, 720);
+    io.DeltaTime = 1.0f / 60.0f;
+    io.IniFilename = NULL;
+
+    u8* pixels;
+    s32 width, height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+    process_mock_response(accounts_json, process_accounts_data);
+    process_mock_response(folder_header_json, process_folder_header_data);
+
+    for (u32 frame = 0; frame < warm_up_frames; frame++) {
+        run_frame(frame);
+    }
+
+    take_heap_allocation_count();
+
+    u32 frames_with_allocations = 0;
+    u32 total_allocations = 0;
+
+    for (u32 frame = 0; frame < checked_frames; frame++) {
+        run_frame(warm_up_frames + frame);
+
+        u32 allocations = take_heap_allocation_count();
+
+        frames_with_allocations += allocations ? 1 : 0;
+        total_allocations += allocations;
+    }
+
+    ImGui::DestroyContext();
+
+    if (total_allocations) {
+        printf("%u allocations in %u of %u frames after warming up\n", total_allocations, frames_with_allocations, checked_frames);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include <cstdio>
+#include <chrono>
+#include "../src/common.h"
+#include "../src/platform.h"
+#include "../src/tracing.h"
+
+/**
+ * Heap traffic shaped like loading a big folder: lots of small blocks from a handful of callsites, arrays
+ *  growing by reallocation, and everything freed again on the next load. Built once per MEMORY_TRACING mode,
+ *  comparing the numbers between the builds gives what tracking costs.
+ */
+
+static const u32 num_blocks = 200000;
+static const u32 num_rounds = 10;
+
+// Colors in common.h are initialized with it, the rest of common.cpp needs the platform
+u32 argb_to_agbr(u32 argb) {
+    return argb;
+}
+
+static double now_ms() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+u64 platform_get_app_time_precise() {
+    return (u64) (now_ms() * 1000.0);
+}
+
+float platform_get_delta_time_ms(u64 delta_to) {
+    return (float) (now_ms() - delta_to / 1000.0);
+}
+
+void platform_write_file(const char* path, void* data, u32 data_length, bool append) {}
+
+// Cheap and deterministic, so every build sees the same sizes
+static u32 next_random(u32& state) {
+    state = state * 1664525 + 1013904223;
+
+    return state >> 8;
+}
+
+static void* allocate_task_like_block(u32 kind, u32 size) {
+    switch (kind) {
+        case 0: return MALLOC(size);
+        case 1: return MALLOC(size * 2);
+        case 2: return CALLOC(size, 1);
+        default: return MALLOC(size + 64);
+    }
+}
+
+static double run_round(void** blocks, u32& random_state) {
+    double started_at = now_ms();
+
+    void** growing = NULL;
+    u32 growing_length = 0;
+    u32 growing_watermark = 0;
+
+    for (u32 index = 0; index < num_blocks; index++) {
+        u32 random = next_random(random_state);
+
+        blocks[index] = allocate_task_like_block(random % 4, 16 + (random >> 4) % 200);
+
+        if (growing_length == growing_watermark) {
+            growing_watermark = MAX(growing_watermark * 2, 16);
+            growing = (void**) REALLOC(growing, sizeof(void*) * growing_watermark);
+        }
+
+        growing[growing_length++] = blocks[index];
+    }
+
+    // Edits grow some of the strings
+    for (u32 index = 0; index < num_blocks; index += 4) {
+        blocks[index] = REALLOC(blocks[index], 512);
+    }
+
+    for (u32 index = 0; index < num_blocks; index++) {
+        FREE(blocks[index]);
+    }
+
+    FREE(growing);
+
+    return now_ms() - started_at;
+}
+
+int main() {
+    void** blocks = (void**) malloc(sizeof(void*) * num_blocks);
+    u32 random_state = 1;
+
+    // Warms up the tracker tables and the allocator
+    run_round(blocks, random_state);
+
+    double best_ms = 1e30;
+    double total_ms = 0;
+
+    for (u32 round = 0; round < num_rounds; round++) {
+        double round_ms = run_round(blocks, random_state);
+
+        best_ms = MIN(best_ms, round_ms);
+        total_ms += round_ms;
+    }
+
+    // Every round does a malloc and a free per block, plus the reallocations
+    u32 operations_per_round = num_blocks * 2 + num_blocks / 4;
+
+    printf("%s memory tracing: best %.2fms, average %.2fms per round, %.1fns per heap operation\n",
+           memory_tracing_mode_name(), best_ms, total_ms / num_rounds, best_ms * 1000000.0 / operations_per_round);
+
+    free(blocks);
+
+    return 0;
+}